@@ -17,6 +17,7 @@ endmacro()
 # ############################################################### #
 macro(generate_basic_options_library NAME)
     option(${NAME}_BUILD_SHARED "Build the ${NAME} as shared." OFF)
+    option(${NAME}_BUILD_TESTS "Build tests of the ${NAME}." OFF)
     set(
         ${NAME}_INSTALL_CMAKE_PREFIX
         "lib/cmake/${NAME}"
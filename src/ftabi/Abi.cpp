@@ -1,5 +1,9 @@
 #include "Abi.hpp"
 
+#include "BatchHash.hpp"
+#include "Profiler.hpp"
+#include "ValueReader.hpp"
+
 #include <crypto/block/block-auto.h>
 #include <crypto/block/check-proof.h>
 #include <crypto/vm/cells/MerkleProof.h>
@@ -9,13 +13,184 @@
 #include <tl/generate/auto/tl/lite_api.h>
 #include <vm/cellops.h>
 #include <vm/cp0.h>
+#include <vm/dict.h>
 #include <vm/memo.h>
 #include <vm/vm.h>
 
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+
 namespace ftabi
 {
 constexpr static auto STD_ADDRESS_BIT_LENGTH = 2 /* tag */ + 1 /* maybe */ + 8 /* workchain */ + 256 /* addr */;
 
+static auto now_ms() -> td::uint64
+{
+    const auto duration = std::chrono::system_clock::now().time_since_epoch();
+    return static_cast<td::uint64>(std::chrono::duration_cast<std::chrono::milliseconds>(duration).count());
+}
+
+// moves cursor to the next cell in chain if current one is exhausted
+auto ensure_bits(vm::CellSlice& cursor, unsigned bits, DecodeBudget& budget) -> bool
+{
+    if (cursor.size() < bits && cursor.empty() && cursor.size_refs() == 1) {
+        if (!budget.visit_cell()) {
+            return false;
+        }
+        cursor = vm::load_cell_slice(cursor.prefetch_ref());
+    }
+    return cursor.have(bits);
+}
+
+// decodes the inline value into the field of the same type, ints are widened to td::BigInt256
+template <typename T>
+static auto read_inline_into(vm::CellSlice& cursor, const Param& param, DecodeBudget& budget, T& result) -> td::Status
+{
+    return read_inline_value(cursor, param, budget, [&](const auto& value) {
+        using V = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, V>) {
+            result = value;
+        }
+        else if constexpr (std::is_same_v<T, td::BigInt256> && (std::is_same_v<V, int64_t> || std::is_same_v<V, uint64_t>)) {
+            result = to_bigint(value);
+        }
+    });
+}
+
+static auto hash_combine(size_t seed, size_t value) -> size_t
+{
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6u) + (seed >> 2u));
+}
+
+static auto hash_bytes(const void* data, size_t size) -> size_t
+{
+    return std::hash<std::string_view>{}(std::string_view{static_cast<const char*>(data), size});
+}
+
+static auto hash_int(const td::BigInt256& value) -> size_t
+{
+    unsigned char bytes[33];
+    CHECK(value.export_bytes(bytes, sizeof(bytes), true))
+    return hash_bytes(bytes, sizeof(bytes));
+}
+
+static auto unwrap_encoded(const Value& value) -> const Value&
+{
+    const auto* encoded = dynamic_cast<const EncodedValue*>(&value);
+    return encoded != nullptr ? *encoded->value : value;
+}
+
+// param
+
+namespace
+{
+struct NameTable {
+    std::mutex mutex{};
+    // keys point to the strings they map to
+    std::unordered_map<std::string_view, std::weak_ptr<const std::string>> names{};
+};
+
+auto name_table() -> NameTable&
+{
+    // never destroyed, static params may release their names after it
+    static auto* table = new NameTable{};
+    return *table;
+}
+
+auto release_name(const std::string* name) -> void
+{
+    auto& table = name_table();
+    {
+        std::lock_guard<std::mutex> lock{table.mutex};
+        // the entry may already belong to a new string with the same name
+        if (auto it = table.names.find(*name); it != table.names.end() && it->first.data() == name->data()) {
+            table.names.erase(it);
+        }
+    }
+    delete name;
+}
+
+}  // namespace
+
+ParamName::ParamName(const std::string& name)
+{
+    auto& table = name_table();
+    std::lock_guard<std::mutex> lock{table.mutex};
+    if (auto it = table.names.find(name); it != table.names.end()) {
+        value_ = it->second.lock();
+        if (value_ != nullptr) {
+            return;
+        }
+        table.names.erase(it);
+    }
+
+    value_ = std::shared_ptr<const std::string>{new std::string{name}, release_name};
+    table.names.emplace(*value_, value_);
+}
+
+// value
+
+auto Value::decode(vm::CellSlice& cursor, bool last) -> td::Status
+{
+    DecodeBudget budget{};
+    return decode(cursor, last, budget);
+}
+
+auto Value::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+{
+    TRY_STATUS(decode(cursor.write(), last))
+    return std::move(cursor);
+}
+
+auto Value::hash() const -> size_t
+{
+    auto result = static_cast<size_t>(param_->type());
+    auto cells = serialize();
+    if (cells.is_error()) {
+        return result;
+    }
+    for (const auto& cell : cells.ok()) {
+        size_t cell_hash;
+        std::memcpy(&cell_hash, cell->get_hash().as_slice().data(), sizeof(cell_hash));
+        result = hash_combine(result, cell_hash);
+    }
+    return result;
+}
+
+auto Value::equals(const Value& other) const -> bool
+{
+    const auto& same = unwrap_encoded(other);
+    if (&same == this) {
+        return true;
+    }
+    if (same.param_->type() != param_->type()) {
+        return false;
+    }
+
+    auto cells = serialize();
+    auto other_cells = same.serialize();
+    if (cells.is_error() || other_cells.is_error() || cells.ok().size() != other_cells.ok().size()) {
+        return false;
+    }
+    for (size_t i = 0; i < cells.ok().size(); ++i) {
+        if (cells.ok()[i]->get_hash() != other_cells.ok()[i]->get_hash()) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // value int
 
 ValueInt::ValueInt(ParamRef param, const td::BigInt256& value)
@@ -32,15 +207,12 @@ auto ValueInt::serialize() const -> td::Result<std::vector<BuilderData>>
     return std::vector{cb.finalize()};
 }
 
-auto ValueInt::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+auto ValueInt::decode(vm::CellSlice& cursor, bool /*last*/, DecodeBudget& budget) -> td::Status
 {
-    TRY_RESULT(sgnd, try_is_signed())
-    auto fetched = cursor.write().fetch_int256(param_->bit_len(), sgnd);
-    if (fetched.is_null()) {
-        return td::Status::Error("invalid value type. int or uint expected");
+    if (auto sgnd = try_is_signed(); sgnd.is_error()) {
+        return sgnd.move_as_error();
     }
-    value = *fetched;
-    return std::move(cursor);
+    return read_inline_into(cursor, *param_, budget, value);
 }
 
 auto ValueInt::to_string() const -> std::string
@@ -48,6 +220,17 @@ auto ValueInt::to_string() const -> std::string
     return value.to_dec_string();
 }
 
+auto ValueInt::hash() const -> size_t
+{
+    return hash_combine(static_cast<size_t>(param_->type()), hash_int(value));
+}
+
+auto ValueInt::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueInt*>(&unwrap_encoded(other));
+    return same != nullptr && same->check_type(param_) && value.cmp(same->value) == 0;
+}
+
 auto ValueInt::try_is_signed() const -> td::Result<bool>
 {
     if (param_->type() == ParamType::Uint) {
@@ -79,12 +262,9 @@ auto ValueBool::serialize() const -> td::Result<std::vector<BuilderData>>
     return std::vector{cb.finalize()};
 }
 
-auto ValueBool::deserialize(SliceData&& cursor, bool /*last*/) -> td::Result<SliceData>
+auto ValueBool::decode(vm::CellSlice& cursor, bool /*last*/, DecodeBudget& budget) -> td::Status
 {
-    if (!cursor.write().fetch_bool_to(value)) {
-        return td::Status::Error("invalid value type. bool expected");
-    }
-    return std::move(cursor);
+    return read_inline_into(cursor, *param_, budget, value);
 }
 
 auto ValueBool::to_string() const -> std::string
@@ -92,6 +272,17 @@ auto ValueBool::to_string() const -> std::string
     return value ? "true" : "false";
 }
 
+auto ValueBool::hash() const -> size_t
+{
+    return hash_combine(static_cast<size_t>(param_->type()), value);
+}
+
+auto ValueBool::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueBool*>(&unwrap_encoded(other));
+    return same != nullptr && value == same->value;
+}
+
 auto ValueBool::make_copy() const -> Value*
 {
     return new ValueBool{param_, value};
@@ -119,17 +310,21 @@ auto ValueTuple::serialize() const -> td::Result<std::vector<BuilderData>>
     return result;
 }
 
-auto ValueTuple::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+auto ValueTuple::decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status
 {
     TRY_RESULT(default_value, param_->default_value())
 
     auto& result_values = dynamic_cast<ValueTuple&>(default_value.write()).values;
 
+    if (!budget.enter()) {
+        return budget.status();
+    }
     for (size_t i = 0; i < result_values.size(); ++i) {
-        TRY_RESULT_ASSIGN(cursor, result_values[i].write().deserialize(std::move(cursor), last && (i + 1 == result_values.size())))
+        TRY_STATUS(result_values[i].write().decode(cursor, last && (i + 1 == result_values.size()), budget))
     }
+    budget.leave();
     values = std::move(result_values);
-    return std::move(cursor);
+    return td::Status::OK();
 }
 
 auto ValueTuple::to_string() const -> std::string
@@ -147,6 +342,29 @@ auto ValueTuple::to_string() const -> std::string
     return result + ")";
 }
 
+auto ValueTuple::hash() const -> size_t
+{
+    auto result = static_cast<size_t>(param_->type());
+    for (const auto& item : values) {
+        result = hash_combine(result, item->hash());
+    }
+    return result;
+}
+
+auto ValueTuple::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueTuple*>(&unwrap_encoded(other));
+    if (same == nullptr || values.size() != same->values.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (!values[i]->equals(*same->values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
 auto ValueTuple::make_copy() const -> Value*
 {
     return new ValueTuple{param_, values};
@@ -154,15 +372,17 @@ auto ValueTuple::make_copy() const -> Value*
 
 // value cell
 
-static auto read_cell(SliceData&& cursor, bool last) -> td::Result<std::pair<td::Ref<vm::Cell>, SliceData>>
+auto read_cell(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Result<td::Ref<vm::Cell>>
 {
-    if (cursor->size_refs() == 1 && !last && cursor->empty()) {
-        cursor = vm::load_cell_slice_ref(cursor.write().fetch_ref());
+    if (cursor.size_refs() == 1 && !last && cursor.empty()) {
+        if (!budget.visit_cell()) {
+            return budget.status();
+        }
+        cursor = vm::load_cell_slice(cursor.prefetch_ref());
     }
 
-    if (cursor->size_refs() > 0) {
-        auto cell = cursor.write().fetch_ref();
-        return std::make_pair(std::move(cell), std::move(cursor));
+    if (cursor.size_refs() > 0) {
+        return cursor.fetch_ref();
     }
     else {
         return td::Status::Error("failed to fetch cell");
@@ -186,11 +406,10 @@ auto ValueCell::serialize() const -> td::Result<std::vector<BuilderData>>
     return std::vector{cb.finalize()};
 }
 
-auto ValueCell::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+auto ValueCell::decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status
 {
-    TRY_RESULT(result, read_cell(std::move(cursor), last))
-    value = std::move(result.first);
-    return std::move(result.second);
+    TRY_RESULT_ASSIGN(value, read_cell(cursor, last, budget))
+    return td::Status::OK();
 }
 
 auto ValueCell::to_string() const -> std::string
@@ -205,6 +424,25 @@ auto ValueCell::to_string() const -> std::string
     return ss.str();
 }
 
+auto ValueCell::hash() const -> size_t
+{
+    if (value.is_null()) {
+        return static_cast<size_t>(param_->type());
+    }
+    size_t result;
+    std::memcpy(&result, value->get_hash().as_slice().data(), sizeof(result));
+    return result;
+}
+
+auto ValueCell::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueCell*>(&unwrap_encoded(other));
+    if (same == nullptr || value.is_null() != same->value.is_null()) {
+        return false;
+    }
+    return value.is_null() || value->get_hash() == same->value->get_hash();
+}
+
 auto ValueCell::make_copy() const -> Value*
 {
     return new ValueCell{param_, value};
@@ -218,150 +456,642 @@ ValueMap::ValueMap(ParamRef param, std::vector<std::pair<ValueRef, ValueRef>> va
 {
 }
 
-auto ValueMap::serialize() const -> td::Result<std::vector<BuilderData>>
+static auto map_key_bit_len(const ParamRef& key) -> td::Result<int>
 {
-    size_t bit_len{};
-    std::unique_ptr<block::gen::TLB> value_type{};
-    if (param_->type() == ParamType::Uint) {
-        bit_len = param_->bit_len();
-        value_type = std::make_unique<block::gen::UInt>(bit_len);
+    switch (key->type()) {
+        case ParamType::Uint:
+        case ParamType::Int:
+            return static_cast<int>(key->bit_len());
+        case ParamType::Address:
+            return static_cast<int>(STD_ADDRESS_BIT_LENGTH);
+        default:
+            return td::Status::Error("only integer and std address values can be used as keys");
     }
-    else if (param_->type() == ParamType::Int) {
-        bit_len = param_->bit_len();
-        value_type = std::make_unique<block::gen::Int>(bit_len);
+}
+
+// abi stores the value by reference if the leaf may not fit it together with the longest label (12 bits of label header)
+static auto map_value_in_ref(const ParamMap& param, int key_len) -> bool
+{
+    return 12 + static_cast<size_t>(key_len) + param.value->max_bit_len() > vm::CellTraits::max_bits ||
+           param.value->max_refs() > vm::CellTraits::max_refs;
+}
+
+// runs `f` for each index on the calling thread and on idle threads of the executor.
+// returns when all indices are done, helpers which start later find nothing to do
+static auto for_each_parallel(size_t count, Executor* executor, const std::function<void(size_t)>& f) -> void
+{
+    const auto thread_count = executor != nullptr ? std::min(executor->concurrency(), count) : 0;
+    if (thread_count <= 1) {
+        for (size_t i = 0; i < count; ++i) {
+            f(i);
+        }
+        return;
     }
-    else if (param_->type() == ParamType::Address) {
-        bit_len = STD_ADDRESS_BIT_LENGTH;
-        value_type = std::make_unique<block::gen::MsgAddress>();
+
+    struct State {
+        explicit State(size_t count, const std::function<void(size_t)>& f)
+            : count{count}
+            , f{f}
+        {
+        }
+
+        auto run() -> void
+        {
+            for (auto i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                f(i);
+                std::lock_guard<std::mutex> lock{mutex};
+                if (++done == count) {
+                    finished.notify_all();
+                }
+            }
+        }
+
+        const size_t count;
+        const std::function<void(size_t)>& f;
+        std::atomic<size_t> next{0};
+        std::mutex mutex{};
+        std::condition_variable finished{};
+        size_t done{0};
+    };
+
+    auto state = std::make_shared<State>(count, f);
+    for (size_t i = 1; i < thread_count; ++i) {
+        executor->execute([state] { state->run(); });
+    }
+    state->run();
+
+    std::unique_lock<std::mutex> lock{state->mutex};
+    state->finished.wait(lock, [&] { return state->done == count; });
+}
+
+namespace
+{
+// builds dictionary from all entries at once, bottom-up, instead of rebuilding the path on each insertion.
+// subtrees below the top forks don't depend on each other and are built in parallel for large maps.
+// cells are the same as the serial build produces, only the order of their creation differs
+class MapBuilder {
+public:
+    MapBuilder(const ParamMap& param, int key_len)
+        : param_{param}
+        , key_len_{key_len}
+        , key_bytes_{static_cast<size_t>(key_len + 7) / 8}
+        , value_in_ref_{map_value_in_ref(param, key_len)}
+    {
+    }
+
+    // returns null cell for empty map
+    auto build(const std::vector<std::pair<ValueRef, ValueRef>>& entries, Executor* executor) -> td::Result<td::Ref<vm::Cell>>
+    {
+        TRY_STATUS(prepare(entries, executor))
+        if (values_.empty()) {
+            return td::Ref<vm::Cell>{};
+        }
+        const auto thread_count = executor != nullptr ? executor->concurrency() : 1;
+        if (thread_count <= 1) {
+            return build_subtree(0, values_.size(), 0);
+        }
+
+        // several tasks per thread smooth out unbalanced subtrees
+        unsigned levels = 3;
+        for (size_t i = 1; i < thread_count; i <<= 1u) {
+            ++levels;
+        }
+
+        std::vector<Task> tasks{};
+        plan(0, values_.size(), 0, levels, tasks);
+
+        std::vector<td::Result<td::Ref<vm::Cell>>> built(tasks.size());
+        for_each_parallel(tasks.size(), executor, [&](size_t i) { built[i] = build_subtree(tasks[i].begin, tasks[i].end, tasks[i].offset); });
+
+        std::vector<td::Ref<vm::Cell>> subtrees{};
+        subtrees.reserve(built.size());
+        for (auto& subtree : built) {
+            TRY_RESULT(cell, std::move(subtree))
+            subtrees.emplace_back(std::move(cell));
+        }
+
+        size_t next = 0;
+        return assemble(0, values_.size(), 0, levels, subtrees, next);
+    }
+
+private:
+    struct Task {
+        size_t begin;
+        size_t end;
+        int offset;
+    };
+
+    // serializes keys, sorts entries by them and keeps the last value of duplicate keys
+    auto prepare(const std::vector<std::pair<ValueRef, ValueRef>>& entries, Executor* executor) -> td::Status
+    {
+        constexpr size_t chunk_size = 1024;
+        std::vector<unsigned char> keys(entries.size() * key_bytes_, 0);
+        std::vector<td::Status> statuses((entries.size() + chunk_size - 1) / chunk_size);
+
+        for_each_parallel(statuses.size(), executor, [&](size_t chunk) {
+            const auto end = std::min(entries.size(), (chunk + 1) * chunk_size);
+            for (auto i = chunk * chunk_size; i < end; ++i) {
+                auto r_key = entries[i].first->serialize();
+                if (r_key.is_error()) {
+                    statuses[chunk] = r_key.move_as_error();
+                    return;
+                }
+                const auto serialized_key = r_key.move_as_ok();
+                if (serialized_key.size() != 1) {
+                    statuses[chunk] = td::Status::Error("map key must be one-cell length");
+                    return;
+                }
+                if (serialized_key[0]->size() != static_cast<unsigned>(key_len_)) {
+                    statuses[chunk] = param_.key->type() == ParamType::Address ? td::Status::Error("only std non-anycast address can be used as map key")
+                                                                               : td::Status::Error("invalid map key length");
+                    return;
+                }
+                const auto key_cs = vm::load_cell_slice(serialized_key[0]);
+                const auto key_bits = key_cs.data_bits();
+                td::bitstring::bits_memcpy(keys.data() + i * key_bytes_, 0, key_bits.ptr, key_bits.offs, key_len_);
+            }
+        });
+        for (auto& status : statuses) {
+            TRY_STATUS(std::move(status))
+        }
+
+        const auto key_at = [&](size_t i) { return td::ConstBitPtr{keys.data() + i * key_bytes_, 0}; };
+        std::vector<size_t> order(entries.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&](size_t left, size_t right) {
+            return td::bitstring::bits_memcmp(key_at(left), key_at(right), key_len_) < 0;
+        });
+
+        keys_.clear();
+        values_.clear();
+        keys_.reserve(keys.size());
+        values_.reserve(entries.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (i + 1 < order.size() && td::bitstring::bits_memcmp(key_at(order[i]), key_at(order[i + 1]), key_len_) == 0) {
+                continue;
+            }
+            const auto* key = keys.data() + order[i] * key_bytes_;
+            keys_.insert(keys_.end(), key, key + key_bytes_);
+            values_.emplace_back(entries[order[i]].second);
+        }
+        return td::Status::OK();
     }
-    else {
-        return td::Status::Error("only integer and std address values can be used as keys");
+
+    auto key(size_t i) const -> td::ConstBitPtr { return td::ConstBitPtr{keys_.data() + i * key_bytes_, 0}; }
+
+    // length of the label of the node holding keys [begin, end), which share first `offset` bits
+    auto label_len(size_t begin, size_t end, int offset) const -> int
+    {
+        if (end - begin == 1) {
+            return key_len_ - offset;
+        }
+        // keys are sorted, so the common prefix of the first and the last key is shared by all of them
+        size_t same_upto = 0;
+        td::bitstring::bits_memcmp(key(begin) + offset, key(end - 1) + offset, static_cast<size_t>(key_len_ - offset), &same_upto);
+        return static_cast<int>(same_upto);
+    }
+
+    // first key with bit at `pos` set
+    auto split_point(size_t begin, size_t end, int pos) const -> size_t
+    {
+        while (begin < end) {
+            const auto mid = begin + (end - begin) / 2;
+            if ((key(mid) + pos).get_uint(1) == 0) {
+                begin = mid + 1;
+            }
+            else {
+                end = mid;
+            }
+        }
+        return begin;
     }
 
-    vm::CellBuilder cb{};
-    block::gen::HashmapE map(static_cast<int>(bit_len), *value_type);
-    for (const auto& [key, value] : values) {
-        TRY_RESULT(serialized_key, key->serialize())
-        if (serialized_key.size() != 1) {
-            return td::Status::Error("map key must be one-cell length");
+    auto build_leaf(size_t index, int offset) const -> td::Result<td::Ref<vm::Cell>>
+    {
+        TRY_RESULT(serialized, values_[index]->serialize())
+
+        vm::CellBuilder cb{};
+        CHECK(vm::dict::append_dict_label(cb, key(index) + offset, key_len_ - offset, key_len_ - offset))
+        if (value_in_ref_) {
+            TRY_RESULT(packed, pack_cells_into_chain(std::move(serialized)))
+            CHECK(cb.store_ref_bool(std::move(packed)))
+        }
+        else {
+            for (const auto& cell : serialized) {
+                if (!cb.append_cellslice_bool(vm::load_cell_slice(cell))) {
+                    return td::Status::Error("map value doesn't fit into leaf");
+                }
+            }
+        }
+        return cb.finalize();
+    }
+
+    auto build_fork(size_t begin, int offset, int label, td::Ref<vm::Cell> left, td::Ref<vm::Cell> right) const -> td::Ref<vm::Cell>
+    {
+        vm::CellBuilder cb{};
+        CHECK(vm::dict::append_dict_label(cb, key(begin) + offset, label, key_len_ - offset))
+        CHECK(cb.store_ref_bool(std::move(left)) && cb.store_ref_bool(std::move(right)))
+        return cb.finalize();
+    }
+
+    auto build_subtree(size_t begin, size_t end, int offset) const -> td::Result<td::Ref<vm::Cell>>
+    {
+        if (end - begin == 1) {
+            return build_leaf(begin, offset);
         }
 
-        if (param_->type() == ParamType::Address && serialized_key[0]->size() != STD_ADDRESS_BIT_LENGTH) {
-            return td::Status::Error("only std non-anycast address can be used as map key");
+        const auto label = label_len(begin, end, offset);
+        const auto mid = split_point(begin, end, offset + label);
+        TRY_RESULT(left, build_subtree(begin, mid, offset + label + 1))
+        TRY_RESULT(right, build_subtree(mid, end, offset + label + 1))
+        return build_fork(begin, offset, label, std::move(left), std::move(right));
+    }
+
+    // splits the top `levels` forks into independent subtrees
+    auto plan(size_t begin, size_t end, int offset, unsigned levels, std::vector<Task>& tasks) const -> void
+    {
+        if (levels == 0 || end - begin == 1) {
+            tasks.emplace_back(Task{begin, end, offset});
+            return;
         }
 
-        TRY_RESULT(serialized_value, value->serialize())
-        TRY_RESULT(packed_value, pack_cells_into_chain(std::move(serialized_value)))
+        const auto label = label_len(begin, end, offset);
+        const auto mid = split_point(begin, end, offset + label);
+        plan(begin, mid, offset + label + 1, levels - 1, tasks);
+        plan(mid, end, offset + label + 1, levels - 1, tasks);
+    }
+
+    // joins subtrees built for `plan` tasks in the same order
+    auto assemble(size_t begin, size_t end, int offset, unsigned levels, std::vector<td::Ref<vm::Cell>>& subtrees, size_t& next) const -> td::Ref<vm::Cell>
+    {
+        if (levels == 0 || end - begin == 1) {
+            return std::move(subtrees[next++]);
+        }
 
-        auto key_cs = vm::load_cell_slice(serialized_key[0]);
-        auto value_cs = vm::load_cell_slice(packed_value);
-        CHECK(map.add_values(cb, key_cs, value_cs))
+        const auto label = label_len(begin, end, offset);
+        const auto mid = split_point(begin, end, offset + label);
+        auto left = assemble(begin, mid, offset + label + 1, levels - 1, subtrees, next);
+        auto right = assemble(mid, end, offset + label + 1, levels - 1, subtrees, next);
+        return build_fork(begin, offset, label, std::move(left), std::move(right));
     }
 
-    return std::vector<BuilderData>{cb.finalize()};
-}
+    const ParamMap& param_;
+    int key_len_;
+    size_t key_bytes_;
+    bool value_in_ref_;
 
-auto ValueMap::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
-{
-    // TODO: implement deserialization
-    return td::Status::Error("not implemented yet");
-}
+    std::vector<unsigned char> keys_{};
+    std::vector<ValueRef> values_{};
+};
 
-auto ValueMap::to_string() const -> std::string
+}  // namespace
+
+static auto serialize_map(const ParamMap& param, const std::vector<std::pair<ValueRef, ValueRef>>& values, Executor* executor)
+    -> td::Result<std::vector<BuilderData>>
 {
-    if (values.empty()) {
-        return "{}";
+    TRY_RESULT(key_len, map_key_bit_len(param.key))
+
+    MapBuilder builder{param, key_len};
+    TRY_RESULT(root, builder.build(values, executor))
+
+    vm::CellBuilder cb{};
+    if (root.is_null()) {
+        CHECK(cb.store_zeroes_bool(1))
     }
-    std::ostringstream ss{};
-    ss << "{";
-    for (size_t i = 0; i < values.size(); ++i) {
-        const auto& [key, value] = values[i];
-        ss << key->to_string() << ": " << value->to_string();
-        if (i + 1 != values.size()) {
-            ss << ", ";
-        }
+    else {
+        CHECK(cb.store_ones_bool(1) && cb.store_ref_bool(std::move(root)))
     }
-    ss << "}";
-    return ss.str();
+    return std::vector<BuilderData>{cb.finalize()};
 }
 
-auto ValueMap::make_copy() const -> Value*
+auto ValueMap::serialize() const -> td::Result<std::vector<BuilderData>>
 {
-    return new ValueMap{param_, values};
+    return serialize_map(static_cast<const ParamMap&>(*param_), values, nullptr);
 }
 
-// value address
-
-ValueAddress::ValueAddress(ParamRef param, const block::StdAddress& value)
-    : Value{std::move(param)}
-    , value{value}
+auto ValueMap::serialize(Executor& executor) const -> td::Result<std::vector<BuilderData>>
 {
+    return serialize_map(static_cast<const ParamMap&>(*param_), values, values.size() >= PARALLEL_MAP_MIN_ENTRIES ? &executor : nullptr);
 }
 
-auto ValueAddress::serialize() const -> td::Result<std::vector<BuilderData>>
+static auto decode_map_key(const ParamRef& param, BitReader& key) -> td::Result<ValueRef>
 {
-    if (param_->type() != ParamType::Address) {
-        return td::Status::Error("invalid param type. address expected");
+    if (param->type() == ParamType::Address) {
+        block::StdAddress address{};
+        TRY_STATUS(read_map_key(key, *param, [&](const auto& value) {
+            if constexpr (std::is_same_v<std::decay_t<decltype(value)>, block::StdAddress>) {
+                address = value;
+            }
+        }))
+        return ValueRef{ValueAddress{param, address}};
     }
 
-    vm::CellBuilder cb{};
-    CHECK(cb.store_long_bool(4, 3)                   // addr_std$10 anycast:(Maybe Anycast)
-          && cb.store_long_bool(value.workchain, 8)  // workchain:int8
-          && cb.store_bits_bool(value.addr));        // addr:bits256
-    return std::vector{cb.finalize()};
+    td::BigInt256 value{};
+    TRY_STATUS(read_map_key(key, *param, [&](const auto& number) {
+        using V = std::decay_t<decltype(number)>;
+        if constexpr (std::is_same_v<V, td::BigInt256>) {
+            value = number;
+        }
+        else if constexpr (std::is_same_v<V, int64_t> || std::is_same_v<V, uint64_t>) {
+            value = to_bigint(number);
+        }
+    }))
+    return ValueRef{ValueInt{param, value}};
 }
 
-auto ValueAddress::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+// calls `f` for each entry of the dictionary with the value slice loaded from its ref if needed
+static auto for_each_map_entry(vm::Dictionary& dict, const ParamMap& param, int key_len, DecodeBudget& budget, const MapEntryCallback& f) -> td::Status
 {
-    switch ((unsigned)cursor.write().fetch_ulong(2)) {
-        case 0b00:                        // addr_none$00 = MsgAddressExt;
-            value = block::StdAddress{};  // -> (0)
-            break;
-        case 0b10: {  // addr_std$10
-            bool is_anycast;
-            int workchain;
-            ton::StdSmcAddress addr;
-            if (cursor.write().fetch_bool_to(is_anycast)      // maybe anycast
-                && !is_anycast                                // anycast is not supported
-                && cursor.write().fetch_int_to(8, workchain)  // workchain_id:int8
-                && cursor.write().fetch_bits_to(addr))        // address:bits256  = MsgAddressInt;
-            {
-                value = block::StdAddress{workchain, addr};
-                break;
+    const auto value_in_ref = map_value_in_ref(param, key_len);
+
+    td::Status status{};
+    try {
+        dict.check_for_each([&](td::Ref<vm::CellSlice> value_cs, td::ConstBitPtr key, int) {
+            if (!budget.consume_map_entries(1)) {
+                status = budget.status();
+                return false;
             }
-            else {
-                return td::Status::Error("failed to fetch address. invalid format");
+
+            vm::CellSlice cs{*value_cs};
+            if (value_in_ref) {
+                if (cs.size_refs() == 0 || !budget.visit_cell()) {
+                    status = budget.exceeded() ? budget.status() : td::Status::Error("failed to fetch map value");
+                    return false;
+                }
+                cs = vm::load_cell_slice(cs.prefetch_ref());
             }
-        }
-        default:
-            return td::Status::Error("failed to fetch address. unknown format");
-    }
 
-    return std::move(cursor);
+            BitReader key_reader{key, static_cast<unsigned>(key_len)};
+            status = f(key_reader, cs);
+            return status.is_ok();
+        });
+    }
+    catch (vm::VmError& err) {
+        return td::Status::Error(PSLICE() << "failed to traverse map: " << err.get_msg());
+    }
+    return status;
 }
 
-auto ValueAddress::to_string() const -> std::string
+static auto decode_map_entries(vm::Dictionary& dict, const ParamMap& param, int key_len, DecodeBudget& budget, std::vector<std::pair<ValueRef, ValueRef>>& entries)
+    -> td::Status
 {
-    return std::to_string(value.workchain) + ":" + value.addr.to_hex();
+    return for_each_map_entry(dict, param, key_len, budget, [&](BitReader& key, vm::CellSlice& cs) -> td::Status {
+        TRY_RESULT(decoded_key, decode_map_key(param.key, key))
+        TRY_RESULT(value, param.value->default_value())
+        TRY_STATUS(value.write().decode(cs, true, budget))
+        entries.emplace_back(std::move(decoded_key), std::move(value));
+        return td::Status::OK();
+    });
 }
 
-auto ValueAddress::make_copy() const -> Value*
+// root of the map value, null for the empty map
+static auto read_map_root(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Result<td::Ref<vm::Cell>>
 {
-    return new ValueAddress{param_, value};
+    bool has_root;
+    if (!ensure_bits(cursor, 1, budget) || !cursor.fetch_bool_to(has_root)) {
+        return budget.exceeded() ? budget.status() : td::Status::Error("failed to fetch map root flag");
+    }
+    if (!has_root) {
+        return td::Ref<vm::Cell>{};
+    }
+    return read_cell(cursor, last, budget);
 }
 
-// value bytes
-
-ValueBytes::ValueBytes(ParamRef param, std::vector<uint8_t> value)
-    : Value{std::move(param)}
-    , value{std::move(value)}
+auto read_map(vm::CellSlice& cursor, const ParamMap& param, bool last, DecodeBudget& budget, const MapEntryCallback& f) -> td::Status
 {
+    TRY_RESULT(key_len, map_key_bit_len(param.key))
+    TRY_RESULT(root, read_map_root(cursor, last, budget))
+    if (root.is_null()) {
+        return td::Status::OK();
+    }
+
+    if (!budget.enter()) {
+        return budget.status();
+    }
+    vm::Dictionary dict{root, key_len};
+    TRY_STATUS(for_each_map_entry(dict, param, key_len, budget, f))
+    budget.leave();
+    return td::Status::OK();
 }
 
-auto ValueBytes::serialize() const -> td::Result<std::vector<BuilderData>>
+// counts leaves of the dictionary, stops at `limit`. invalid cells are left for the decoder to report
+static auto count_map_entries(const td::Ref<vm::Cell>& root, int key_len, size_t limit) -> size_t
 {
-    if (param_->type() != ParamType::Bytes || param_->type() != ParamType::FixedBytes) {
-        return td::Status::Error("invalid param type. bytes or fixed bytes expected");
+    size_t count = 0;
+    std::vector<std::pair<td::Ref<vm::Cell>, int>> stack{{root, key_len}};
+    try {
+        while (!stack.empty() && count < limit) {
+            auto [cell, n] = std::move(stack.back());
+            stack.pop_back();
+
+            vm::dict::LabelParser label{std::move(cell), n, vm::dict::LabelParser::chk_size};
+            if (label.l_bits == n) {
+                ++count;
+                continue;
+            }
+            const auto child_len = n - label.l_bits - 1;
+            stack.emplace_back(label.remainder->prefetch_ref(1), child_len);
+            stack.emplace_back(label.remainder->prefetch_ref(0), child_len);
+        }
+    }
+    catch (vm::VmError&) {
+    }
+    return count;
+}
+
+static auto decode_map_parallel(const td::Ref<vm::Cell>& root, const ParamMap& param, int key_len, DecodeBudget& budget)
+    -> td::Result<std::vector<std::pair<ValueRef, ValueRef>>>
+{
+    constexpr int max_split_bits = 6;
+    const auto split_bits = std::min(max_split_bits, key_len);
+    const size_t part_count = size_t{1} << static_cast<unsigned>(split_bits);
+
+    // parts are disjoint subtrees under each key prefix, so concatenating them keeps key order
+    std::vector<std::vector<std::pair<ValueRef, ValueRef>>> parts(part_count);
+    std::vector<td::Status> statuses(part_count);
+
+    DecodeBudget::SharedCounters shared{};
+    budget.share(shared);
+    std::vector<DecodeBudget> budgets{};
+    budgets.reserve(part_count);
+    for (size_t i = 0; i < part_count; ++i) {
+        budgets.emplace_back(budget.fork(shared));
+    }
+
+    for_each_parallel(part_count, budget.limits().executor, [&](size_t i) {
+        td::BitArray<max_split_bits> prefix{};
+        prefix.bits().store_uint(i, split_bits);
+        try {
+            vm::Dictionary dict{root, key_len};
+            if (!dict.cut_prefix_subdict(prefix.cbits(), split_bits)) {
+                statuses[i] = td::Status::Error("failed to split map");
+                return;
+            }
+            statuses[i] = decode_map_entries(dict, param, key_len, budgets[i], parts[i]);
+        }
+        catch (vm::VmError& err) {
+            statuses[i] = td::Status::Error(PSLICE() << "failed to split map: " << err.get_msg());
+        }
+    });
+
+    size_t total = 0;
+    for (size_t i = 0; i < part_count; ++i) {
+        const auto joined = budget.join(shared, budgets[i]);
+        if (statuses[i].is_error()) {
+            return budget.exceeded() ? budget.status() : std::move(statuses[i]);
+        }
+        if (!joined) {
+            return budget.status();
+        }
+        total += parts[i].size();
+    }
+
+    std::vector<std::pair<ValueRef, ValueRef>> result{};
+    result.reserve(total);
+    for (auto& part : parts) {
+        std::move(part.begin(), part.end(), std::back_inserter(result));
+    }
+    return std::move(result);
+}
+
+auto ValueMap::decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status
+{
+    const auto& param = static_cast<const ParamMap&>(*param_);
+    TRY_RESULT(key_len, map_key_bit_len(param.key))
+
+    TRY_RESULT(root, read_map_root(cursor, last, budget))
+    values.clear();
+    if (root.is_null()) {
+        return td::Status::OK();
+    }
+
+    if (!budget.enter()) {
+        return budget.status();
+    }
+    budget.enter_map();
+    auto status = [&]() -> td::Status {
+        const auto min_entries = budget.limits().parallel_map_min_entries;
+        if (min_entries != 0 && budget.limits().executor != nullptr && budget.outermost_map() &&
+            count_map_entries(root, key_len, min_entries) >= min_entries) {
+            TRY_RESULT_ASSIGN(values, decode_map_parallel(root, param, key_len, budget))
+            return td::Status::OK();
+        }
+        vm::Dictionary dict{root, key_len};
+        return decode_map_entries(dict, param, key_len, budget, values);
+    }();
+    budget.leave_map();
+    TRY_STATUS(std::move(status))
+    budget.leave();
+    return td::Status::OK();
+}
+
+auto ValueMap::to_string() const -> std::string
+{
+    if (values.empty()) {
+        return "{}";
+    }
+    std::ostringstream ss{};
+    ss << "{";
+    for (size_t i = 0; i < values.size(); ++i) {
+        const auto& [key, value] = values[i];
+        ss << key->to_string() << ": " << value->to_string();
+        if (i + 1 != values.size()) {
+            ss << ", ";
+        }
+    }
+    ss << "}";
+    return ss.str();
+}
+
+auto ValueMap::hash() const -> size_t
+{
+    auto result = static_cast<size_t>(param_->type());
+    for (const auto& [key, value] : values) {
+        result = hash_combine(hash_combine(result, key->hash()), value->hash());
+    }
+    return result;
+}
+
+auto ValueMap::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueMap*>(&unwrap_encoded(other));
+    if (same == nullptr || values.size() != same->values.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (!values[i].first->equals(*same->values[i].first) || !values[i].second->equals(*same->values[i].second)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto ValueMap::make_copy() const -> Value*
+{
+    return new ValueMap{param_, values};
+}
+
+// value address
+
+ValueAddress::ValueAddress(ParamRef param, const block::StdAddress& value)
+    : Value{std::move(param)}
+    , value{value}
+{
+}
+
+auto ValueAddress::serialize() const -> td::Result<std::vector<BuilderData>>
+{
+    if (param_->type() != ParamType::Address) {
+        return td::Status::Error("invalid param type. address expected");
+    }
+
+    vm::CellBuilder cb{};
+    CHECK(cb.store_long_bool(4, 3)                   // addr_std$10 anycast:(Maybe Anycast)
+          && cb.store_long_bool(value.workchain, 8)  // workchain:int8
+          && cb.store_bits_bool(value.addr));        // addr:bits256
+    return std::vector{cb.finalize()};
+}
+
+auto ValueAddress::decode(vm::CellSlice& cursor, bool /*last*/, DecodeBudget& budget) -> td::Status
+{
+    return read_inline_into(cursor, *param_, budget, value);
+}
+
+auto ValueAddress::to_string() const -> std::string
+{
+    return std::to_string(value.workchain) + ":" + value.addr.to_hex();
+}
+
+auto ValueAddress::hash() const -> size_t
+{
+    return hash_combine(static_cast<size_t>(value.workchain), hash_bytes(value.addr.data(), 32));
+}
+
+auto ValueAddress::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueAddress*>(&unwrap_encoded(other));
+    return same != nullptr && value.workchain == same->value.workchain && value.addr == same->value.addr;
+}
+
+auto ValueAddress::make_copy() const -> Value*
+{
+    return new ValueAddress{param_, value};
+}
+
+// value bytes
+
+ValueBytes::ValueBytes(ParamRef param, InlineBytes value)
+    : Value{std::move(param)}
+    , value{std::move(value)}
+{
+}
+
+auto ValueBytes::serialize() const -> td::Result<std::vector<BuilderData>>
+{
+    if (param_->type() != ParamType::Bytes && param_->type() != ParamType::FixedBytes) {
+        return td::Status::Error("invalid param type. bytes or fixed bytes expected");
     }
 
     constexpr size_t cell_len = vm::DataCell::max_bits / 8;
@@ -394,64 +1124,88 @@ auto ValueBytes::serialize() const -> td::Result<std::vector<BuilderData>>
     return std::vector{cb.finalize()};
 }
 
-auto ValueBytes::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+auto ValueBytes::decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status
 {
-    TRY_RESULT(cell_cursor, read_cell(std::move(cursor), last))
-    td::Ref<vm::Cell> cell = std::move(cell_cursor.first);
+    InlineBytes result_buffer{};
+    TRY_STATUS(read_bytes(cursor, *param_, last, budget, result_buffer))
+    value = std::move(result_buffer);
+    return td::Status::OK();
+}
 
-    TRY_RESULT(default_value, param_->default_value())
-    auto& result_buffer = dynamic_cast<ValueBytes&>(default_value.write()).value;
+auto ValueBytes::to_string() const -> std::string
+{
+    return td::buffer_to_hex(td::Slice{value.data(), value.size()});
+}
 
-    size_t total_size;
-    std::vector<td::BufferSlice> slices;
+auto ValueBytes::hash() const -> size_t
+{
+    return hash_bytes(value.data(), value.size());
+}
 
-    auto cs = vm::load_cell_slice(cell);
-    while (true) {
-        td::BufferSlice slice{cs.size() / 8};
-        if (!cs.fetch_bytes(slice.as_slice())) {
-            return td::Status::Error("failed to fetch slice");
-        }
+auto ValueBytes::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueBytes*>(&unwrap_encoded(other));
+    return same != nullptr && same->check_type(param_) && value == same->value;
+}
 
-        total_size += slice.size();
-        slices.emplace_back(std::move(slice));
+auto ValueBytes::make_copy() const -> Value*
+{
+    return new ValueBytes{param_, value};
+}
 
-        if (cs.fetch_ref_to(cell)) {
-            cs = vm::load_cell_slice(cell);
-        }
-        else {
-            break;
-        }
-    }
+// value gram
 
-    if (!result_buffer.empty() && result_buffer.size() != total_size) {
-        return td::Status::Error("size of fixed bytes is not correspond to expected size");
+auto store_grams(vm::CellBuilder& cb, GramAmount value) -> bool
+{
+    if (!value.fits()) {
+        return false;
     }
 
-    total_size = 0;
-    for (const auto& slice : slices) {
-        std::memcpy(result_buffer.data() + total_size, slice.data(), slice.size());
+    const auto bits = value.hi != 0 ? 128 - td::count_leading_zeroes64(value.hi) : 64 - (value.lo != 0 ? td::count_leading_zeroes64(value.lo) : 64);
+    const auto len = static_cast<unsigned>((bits + 7) / 8);
+    if (!cb.store_long_bool(len, 4)) {
+        return false;
     }
-
-    value = std::move(result_buffer);
-    return std::move(cell_cursor.second);
+    if (len > 8) {
+        return cb.store_long_bool(static_cast<long long>(value.hi), (len - 8) * 8) && cb.store_long_bool(static_cast<long long>(value.lo), 64);
+    }
+    return len == 0 || cb.store_long_bool(static_cast<long long>(value.lo), len * 8);
 }
 
-auto ValueBytes::to_string() const -> std::string
+auto fetch_grams(vm::CellSlice& cs, GramAmount& value) -> bool
 {
-    return td::buffer_to_hex(td::Slice{value.data(), value.size()});
+    BitReader reader{cs};
+    return fetch_grams(reader, value) && cs.advance(reader.consumed());
 }
 
-auto ValueBytes::make_copy() const -> Value*
+ValueGram::ValueGram(ParamRef param, GramAmount value)
+    : Value{std::move(param)}
+    , value{value}
 {
-    return new ValueBytes{param_, value};
 }
 
-// value gram
+auto ValueGram::create(ParamRef param, GramAmount value) -> td::Result<ValueGram>
+{
+    if (!value.fits()) {
+        return td::Status::Error("grams value is out of range");
+    }
+    return ValueGram{std::move(param), value};
+}
 
-ValueGram::ValueGram(ParamRef param, td::RefInt256 value)
-    : Value{std::move(param)}
-    , value{std::move(value)}
+auto ValueGram::create(ParamRef param, const td::RefInt256& value) -> td::Result<ValueGram>
 {
+    unsigned char bytes[16];
+    if (value.is_null() || td::sgn(value) < 0 || !value->unsigned_fits_bits(GramAmount::MAX_BITS) ||
+        !value->export_bytes(bytes, sizeof(bytes), false)) {
+        return td::Status::Error("grams value is out of range");
+    }
+
+    GramAmount amount{};
+    for (size_t i = 0; i < 8; ++i) {
+        amount.hi = (amount.hi << 8u) | bytes[i];
+        amount.lo = (amount.lo << 8u) | bytes[i + 8];
+    }
+    return ValueGram{std::move(param), amount};
 }
 
 auto ValueGram::serialize() const -> td::Result<std::vector<BuilderData>>
@@ -461,23 +1215,49 @@ auto ValueGram::serialize() const -> td::Result<std::vector<BuilderData>>
     }
 
     vm::CellBuilder cb{};
-    CHECK(block::tlb::t_Grams.store_integer_ref(cb, value))
+    if (!store_grams(cb, value)) {
+        return td::Status::Error("grams value is out of range");
+    }
     return std::vector{cb.finalize()};
 }
 
-auto ValueGram::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+auto ValueGram::decode(vm::CellSlice& cursor, bool /*last*/, DecodeBudget& budget) -> td::Status
 {
-    auto grams = block::tlb::t_Grams.as_integer_skip(cursor.write());
-    if (grams.is_null()) {
-        return td::Status::Error("failed to parse grams");
-    }
-    value = std::move(grams);
-    return std::move(cursor);
+    return read_inline_into(cursor, *param_, budget, value);
 }
 
 auto ValueGram::to_string() const -> std::string
 {
-    return "$" + value->to_dec_string();
+    // long division by 10 in 32 bit halves, so the remainder never overflows a word
+    char buffer[40];
+    auto* ptr = buffer + sizeof(buffer);
+    auto rest = value;
+    do {
+        uint64_t remainder = rest.hi % 10;
+        rest.hi /= 10;
+        const auto upper = (remainder << 32u) | (rest.lo >> 32u);
+        remainder = upper % 10;
+        const auto lower = (remainder << 32u) | (rest.lo & 0xffffffffu);
+        rest.lo = ((upper / 10) << 32u) | (lower / 10);
+        *--ptr = static_cast<char>('0' + lower % 10);
+    } while (rest != GramAmount{});
+    return "$" + std::string{ptr, static_cast<size_t>(buffer + sizeof(buffer) - ptr)};
+}
+
+auto ValueGram::hash() const -> size_t
+{
+    return hash_combine(hash_combine(static_cast<size_t>(param_->type()), static_cast<size_t>(value.hi)), static_cast<size_t>(value.lo));
+}
+
+auto ValueGram::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueGram*>(&unwrap_encoded(other));
+    return same != nullptr && value == same->value;
+}
+
+auto ValueGram::to_int() const -> td::RefInt256
+{
+    return td::RefInt256{true, to_bigint(value)};
 }
 
 auto ValueGram::make_copy() const -> Value*
@@ -504,15 +1284,9 @@ auto ValueTime::serialize() const -> td::Result<std::vector<BuilderData>>
     return std::vector{cb.finalize()};
 }
 
-auto ValueTime::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+auto ValueTime::decode(vm::CellSlice& cursor, bool /*last*/, DecodeBudget& budget) -> td::Status
 {
-    unsigned long long result;
-    if (!cursor.write().fetch_ulong_bool(64, result)) {
-        return td::Status::Error("failed to fetch time");
-    }
-
-    value = result;
-    return std::move(cursor);
+    return read_inline_into(cursor, *param_, budget, value);
 }
 
 auto ValueTime::to_string() const -> std::string
@@ -520,6 +1294,17 @@ auto ValueTime::to_string() const -> std::string
     return std::to_string(value);
 }
 
+auto ValueTime::hash() const -> size_t
+{
+    return hash_combine(static_cast<size_t>(param_->type()), value);
+}
+
+auto ValueTime::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueTime*>(&unwrap_encoded(other));
+    return same != nullptr && value == same->value;
+}
+
 auto ValueTime::make_copy() const -> Value*
 {
     return new ValueTime{param_, value};
@@ -544,15 +1329,9 @@ auto ValueExpire::serialize() const -> td::Result<std::vector<BuilderData>>
     return std::vector{cb.finalize()};
 }
 
-auto ValueExpire::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+auto ValueExpire::decode(vm::CellSlice& cursor, bool /*last*/, DecodeBudget& budget) -> td::Status
 {
-    unsigned long long result;
-    if (!cursor.write().fetch_ulong_bool(32, result)) {
-        return td::Status::Error("failed to fetch time");
-    }
-
-    value = static_cast<uint32_t>(result);
-    return std::move(cursor);
+    return read_inline_into(cursor, *param_, budget, value);
 }
 
 auto ValueExpire::to_string() const -> std::string
@@ -560,6 +1339,17 @@ auto ValueExpire::to_string() const -> std::string
     return std::to_string(value);
 }
 
+auto ValueExpire::hash() const -> size_t
+{
+    return hash_combine(static_cast<size_t>(param_->type()), value);
+}
+
+auto ValueExpire::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValueExpire*>(&unwrap_encoded(other));
+    return same != nullptr && value == same->value;
+}
+
 auto ValueExpire::make_copy() const -> Value*
 {
     return new ValueExpire{param_, value};
@@ -567,10 +1357,29 @@ auto ValueExpire::make_copy() const -> Value*
 
 // value public key
 
-ValuePublicKey::ValuePublicKey(ParamRef param, std::optional<td::SecureString> value)
+ValuePublicKey::ValuePublicKey(ParamRef param, std::optional<td::Bits256> value)
     : Value{std::move(param)}
-    , value{std::move(value)}
+    , value{value}
+{
+}
+
+auto ValuePublicKey::create(ParamRef param, const td::SecureString& value) -> td::Result<ValuePublicKey>
 {
+    if (value.size() != 32) {
+        return td::Status::Error("invalid public key size");
+    }
+
+    td::Bits256 key;
+    key.as_slice().copy_from(value.as_slice());
+    return ValuePublicKey{std::move(param), std::optional{key}};
+}
+
+auto ValuePublicKey::create(ParamRef param, const std::optional<td::SecureString>& value) -> td::Result<ValuePublicKey>
+{
+    if (!value.has_value()) {
+        return ValuePublicKey{std::move(param), std::optional<td::Bits256>{}};
+    }
+    return create(std::move(param), *value);
 }
 
 auto ValuePublicKey::serialize() const -> td::Result<std::vector<BuilderData>>
@@ -581,7 +1390,7 @@ auto ValuePublicKey::serialize() const -> td::Result<std::vector<BuilderData>>
 
     vm::CellBuilder cb{};
     if (value) {
-        CHECK(cb.store_long_bool(1, 1) && cb.store_bytes_bool(value.value()));
+        CHECK(cb.store_long_bool(1, 1) && cb.store_bits_bool(*value));
     }
     else {
         CHECK(cb.store_long_bool(0, 1));
@@ -589,42 +1398,121 @@ auto ValuePublicKey::serialize() const -> td::Result<std::vector<BuilderData>>
     return std::vector{cb.finalize()};
 }
 
-auto ValuePublicKey::deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>
+auto ValuePublicKey::decode(vm::CellSlice& cursor, bool /*last*/, DecodeBudget& budget) -> td::Status
 {
-    bool has_value;
-    if (!cursor.write().fetch_bool_to(has_value)) {
-        return td::Status::Error("failed to fetch public key maybe tag");
-    }
-    if (has_value) {
-        td::SecureString data(32);
-        if (!cursor.write().fetch_bytes(data.as_mutable_slice())) {
-            return td::Status::Error("failed to fetch public key data");
-        }
-        value = std::make_optional(std::move(data));
-    }
-    else {
-        value = std::nullopt;
-    }
-    return std::move(cursor);
+    return read_inline_into(cursor, *param_, budget, value);
 }
 
 auto ValuePublicKey::to_string() const -> std::string
 {
     if (value.has_value()) {
-        return td::buffer_to_hex(value->as_slice());
+        return value->to_hex();
     }
     else {
         return "null";
     }
 }
 
+auto ValuePublicKey::hash() const -> size_t
+{
+    if (!value.has_value()) {
+        return static_cast<size_t>(param_->type());
+    }
+    return hash_bytes(value->data(), 32);
+}
+
+auto ValuePublicKey::equals(const Value& other) const -> bool
+{
+    const auto* same = dynamic_cast<const ValuePublicKey*>(&unwrap_encoded(other));
+    if (same == nullptr || value.has_value() != same->value.has_value()) {
+        return false;
+    }
+    return !value.has_value() || *value == *same->value;
+}
+
 auto ValuePublicKey::make_copy() const -> Value*
 {
-    std::optional<td::SecureString> copy{};
-    if (value.has_value()) {
-        copy = value->copy();
+    return new ValuePublicKey{param_, value};
+}
+
+// encoded value
+
+EncodedValue::EncodedValue(ValueRef value, std::vector<BuilderData> cells)
+    : Value{value->param()}
+    , value{std::move(value)}
+    , cells{std::move(cells)}
+{
+}
+
+auto EncodedValue::serialize() const -> td::Result<std::vector<BuilderData>>
+{
+    return cells;
+}
+
+auto EncodedValue::decode(vm::CellSlice& /*cursor*/, bool /*last*/, DecodeBudget& /*budget*/) -> td::Status
+{
+    return td::Status::Error("encoded value can't be decoded");
+}
+
+auto EncodedValue::to_string() const -> std::string
+{
+    return value->to_string();
+}
+
+auto EncodedValue::hash() const -> size_t
+{
+    return value->hash();
+}
+
+auto EncodedValue::equals(const Value& other) const -> bool
+{
+    return value->equals(other);
+}
+
+auto EncodedValue::make_copy() const -> Value*
+{
+    return new EncodedValue{value, cells};
+}
+
+auto make_encoded(const ValueRef& value) -> td::Result<ValueRef>
+{
+    if (auto encoded = dynamic_cast<const EncodedValue*>(value.get()); encoded != nullptr) {
+        return value;
+    }
+    TRY_RESULT(cells, value->serialize())
+    return ValueRef{EncodedValue{value, std::move(cells)}};
+}
+
+auto skip_value(vm::CellSlice& cursor, const Param& param, bool last, DecodeBudget& budget) -> td::Status
+{
+    switch (param.type()) {
+        case ParamType::Cell:
+        case ParamType::Bytes:
+        case ParamType::FixedBytes: {
+            auto r_cell = read_cell(cursor, last, budget);
+            return r_cell.is_error() ? r_cell.move_as_error() : td::Status::OK();
+        }
+        case ParamType::Map: {
+            auto r_root = read_map_root(cursor, last, budget);
+            return r_root.is_error() ? r_root.move_as_error() : td::Status::OK();
+        }
+        case ParamType::Tuple: {
+            const auto& items = static_cast<const ParamTuple&>(param).items;
+            if (!budget.enter()) {
+                return budget.status();
+            }
+            for (size_t i = 0; i < items.size(); ++i) {
+                TRY_STATUS(skip_value(cursor, *items[i], last && i + 1 == items.size(), budget))
+            }
+            budget.leave();
+            return td::Status::OK();
+        }
+        case ParamType::Array:
+        case ParamType::FixedArray:
+            return td::Status::Error("arrays are not supported");
+        default:
+            return read_inline_value(cursor, param, budget, [](const auto&) {});
     }
-    return new ValuePublicKey{param_, std::move(copy)};
 }
 
 // functions
@@ -642,6 +1530,32 @@ auto fill_signature(const std::optional<td::SecureString>& signature, BuilderDat
     return cb.finalize();
 }
 
+auto fill_signature(const std::optional<td::SecureString>& signature, const UnsignedCall& call) -> td::Result<BuilderData>
+{
+    auto cs = vm::load_cell_slice(call.body);
+    bool has_placeholder;
+    if (!cs.fetch_bool_to(has_placeholder) || (has_placeholder && !cs.advance(512))) {
+        return td::Status::Error("invalid unsigned call body");
+    }
+    if (!has_placeholder) {
+        if (signature.has_value()) {
+            return td::Status::Error("unsigned call body has no place for signature");
+        }
+        return call.body;
+    }
+
+    vm::CellBuilder cb{};
+    if (signature.has_value()) {
+        CHECK(cb.store_long_bool(1, 1) && cb.store_bytes_bool(signature.value().as_slice()))
+    }
+    else {
+        CHECK(cb.store_long_bool(0, 1))
+    }
+    CHECK(cb.append_cellslice_bool(cs))
+
+    return cb.finalize();
+}
+
 auto pack_cells_into_chain(std::vector<BuilderData>&& cells) -> td::Result<BuilderData>
 {
     if (cells.empty()) {
@@ -703,6 +1617,71 @@ auto pack_cells_into_chain(std::vector<BuilderData>&& cells) -> td::Result<Build
     return td::Status::Error("empty packed data");
 }
 
+auto append_leaf_sizes(const ParamRef& param, LeafSizes& sizes) -> void
+{
+    if (param->type() == ParamType::Tuple) {
+        for (const auto& item : static_cast<const ParamTuple&>(*param).items) {
+            append_leaf_sizes(item, sizes);
+        }
+    }
+    else {
+        sizes.emplace_back(param->max_bit_len(), param->max_refs());
+    }
+}
+
+auto compute_fixed_layout(const LeafSizes& sizes) -> td::Result<CellLayout>
+{
+    CellLayout layout{};
+    layout.reserve(sizes.size());
+
+    uint16_t cell = 0;
+    size_t bits = 0;
+    size_t refs = 0;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        const auto [max_bits, max_refs] = sizes[i];
+        if (max_bits > vm::CellTraits::max_bits || max_refs > vm::CellTraits::max_refs - 1) {
+            return td::Status::Error("param doesn't fit into one cell");
+        }
+
+        // one reference is reserved for the next cell in chain unless this is the last value
+        const auto refs_limit = i + 1 == sizes.size() ? vm::CellTraits::max_refs : vm::CellTraits::max_refs - 1;
+        if (bits + max_bits > vm::CellTraits::max_bits || refs + max_refs > refs_limit) {
+            ++cell;
+            bits = 0;
+            refs = 0;
+        }
+        bits += max_bits;
+        refs += max_refs;
+        layout.emplace_back(cell);
+    }
+    return layout;
+}
+
+auto pack_cells_by_layout(std::vector<BuilderData>&& cells, const CellLayout& layout) -> td::Result<BuilderData>
+{
+    if (cells.empty()) {
+        return td::Status::Error("no cells to pack");
+    }
+    if (cells.size() != layout.size()) {
+        return td::Status::Error("cells don't correspond to layout");
+    }
+
+    std::vector<vm::CellBuilder> builders(layout.back() + 1u);
+    for (size_t i = 0; i < cells.size(); ++i) {
+        if (!builders[layout[i]].append_data_cell_bool(cells[i])) {
+            return td::Status::Error("value exceeds its max size");
+        }
+    }
+
+    auto result = builders.back().finalize();
+    for (size_t i = builders.size() - 1; i > 0; --i) {
+        auto& builder = builders[i - 1];
+        CHECK(builder.store_ref_bool(std::move(result)))
+        result = builder.finalize();
+    }
+    return result;
+}
+
 auto check_params(const std::vector<ValueRef>& values, const std::vector<ParamRef>& params) -> bool
 {
     if (values.size() != params.size()) {
@@ -760,6 +1739,96 @@ auto compute_function_signature(const std::string& name, const InputParams& inpu
     return name + inputs_signature + ")" + outputs_signature + ")v" + std::to_string(ABI_VERSION);
 }
 
+auto HeaderSlots::set_time(td::uint64 value) -> HeaderSlots&
+{
+    time = value;
+    return *this;
+}
+
+auto HeaderSlots::set_expire(uint32_t value) -> HeaderSlots&
+{
+    expire = value;
+    return *this;
+}
+
+auto HeaderSlots::set_pubkey(const td::Bits256& value) -> HeaderSlots&
+{
+    pubkey = value;
+    return *this;
+}
+
+auto HeaderSlots::set(size_t slot, ValueRef value) -> td::Status
+{
+    if (slot >= MAX_HEADER_SLOTS) {
+        return td::Status::Error("header slot out of range");
+    }
+    values[slot] = std::move(value);
+    return td::Status::OK();
+}
+
+// signing key
+
+auto SigningKey::create(const td::Ed25519::PrivateKey& private_key) -> td::Result<td::Ref<SigningKey>>
+{
+    const auto secret = private_key.as_octet_string();
+    auto* pkey = EVP_PKEY_new_raw_private_key(EVP_PKEY_ED25519, nullptr, secret.as_slice().ubegin(), secret.size());
+    if (pkey == nullptr) {
+        return td::Status::Error("failed to import private key");
+    }
+
+    td::Bits256 public_key{};
+    size_t public_key_len = 32;
+    if (EVP_PKEY_get_raw_public_key(pkey, public_key.data(), &public_key_len) != 1 || public_key_len != 32) {
+        EVP_PKEY_free(pkey);
+        return td::Status::Error("failed to derive public key");
+    }
+    return td::Ref<SigningKey>{SigningKey{pkey, public_key}};
+}
+
+SigningKey::SigningKey(::evp_pkey_st* pkey, const td::Bits256& public_key)
+    : pkey_{pkey}
+    , public_key_{public_key}
+{
+}
+
+SigningKey::SigningKey(SigningKey&& other) noexcept
+    : pkey_{std::exchange(other.pkey_, nullptr)}
+    , public_key_{other.public_key_}
+{
+}
+
+SigningKey::~SigningKey()
+{
+    EVP_PKEY_free(pkey_);
+}
+
+auto SigningKey::sign(td::Slice data) const -> td::Result<td::SecureString>
+{
+    auto* ctx = EVP_MD_CTX_new();
+    if (ctx == nullptr) {
+        return td::Status::Error("failed to create signing context");
+    }
+
+    td::SecureString signature{64};
+    size_t signature_len = signature.size();
+    const auto ok = EVP_DigestSignInit(ctx, nullptr, nullptr, nullptr, pkey_) == 1 &&
+                    EVP_DigestSign(ctx, signature.as_mutable_slice().ubegin(), &signature_len, data.ubegin(), data.size()) == 1 &&
+                    signature_len == signature.size();
+    EVP_MD_CTX_free(ctx);
+    if (!ok) {
+        return td::Status::Error("failed to sign data");
+    }
+    return std::move(signature);
+}
+
+auto SigningKey::make_copy() const -> SigningKey*
+{
+    CHECK(EVP_PKEY_up_ref(pkey_) == 1)
+    return new SigningKey{pkey_, public_key_};
+}
+
+// function call
+
 FunctionCall::FunctionCall(InputValues&& inputs)
     : inputs{std::move(inputs)}
 {
@@ -779,6 +1848,21 @@ FunctionCall::FunctionCall(HeaderValues&& header, InputValues&& inputs, bool int
 {
 }
 
+FunctionCall::FunctionCall(HeaderSlots&& header, InputValues&& inputs, bool internal, std::optional<td::Ed25519::PrivateKey>&& private_key)
+    : header_slots{std::move(header)}
+    , inputs{std::move(inputs)}
+    , internal{internal}
+    , private_key{std::move(private_key)}
+{
+}
+
+FunctionCall::FunctionCall(HeaderSlots&& header, InputValues&& inputs, td::Ref<SigningKey> signing_key)
+    : header_slots{std::move(header)}
+    , inputs{std::move(inputs)}
+    , signing_key{std::move(signing_key)}
+{
+}
+
 auto FunctionCall::make_copy() const -> FunctionCall*
 {
     auto header_copy = header;
@@ -787,9 +1871,64 @@ auto FunctionCall::make_copy() const -> FunctionCall*
     if (private_key.has_value()) {
         private_key_copy = std::make_optional(td::Ed25519::PrivateKey(private_key->as_octet_string().copy()));
     }
-    return new FunctionCall{std::move(header_copy), std::move(inputs_copy), internal, std::move(private_key_copy)};
+    auto* result = new FunctionCall{std::move(header_copy), std::move(inputs_copy), internal, std::move(private_key_copy)};
+    result->header_slots = header_slots;
+    result->signing_key = signing_key;
+    result->body_as_ref = body_as_ref;
+    return result;
 }
 
+namespace
+{
+// follows cell boundaries of the fixed layout between top-level params. without cells the chain is followed
+// only when the current cell is exhausted, as values do themselves
+class LayoutTracker {
+public:
+    LayoutTracker() = default;
+    LayoutTracker(const ParamCells& cells, size_t item, uint16_t cell)
+        : cells_{&cells}
+        , item_{item}
+        , cell_{cell}
+    {
+    }
+
+    // moves the cursor to the cell where the next param starts
+    auto enter(vm::CellSlice& cursor, DecodeBudget& budget) -> td::Status
+    {
+        if (cells_ == nullptr) {
+            return td::Status::OK();
+        }
+        const auto first = (*cells_)[item_].first;
+        if (first == cell_) {
+            return td::Status::OK();
+        }
+        if (first != cell_ + 1 || !cursor.empty() || cursor.size_refs() != 1) {
+            return td::Status::Error("body doesn't match the fixed layout");
+        }
+        if (!budget.visit_cell()) {
+            return budget.status();
+        }
+        cursor = vm::load_cell_slice(cursor.prefetch_ref());
+        cell_ = first;
+        return td::Status::OK();
+    }
+
+    // the param may span several cells, the next one starts after its last leaf
+    auto leave() -> void
+    {
+        if (cells_ != nullptr) {
+            cell_ = (*cells_)[item_++].second;
+        }
+    }
+
+private:
+    const ParamCells* cells_{};
+    size_t item_{};
+    uint16_t cell_{};
+};
+
+}  // namespace
+
 Function::Function(std::string&& name, HeaderParams&& header, InputParams&& inputs, OutputParams&& outputs, uint32_t input_id, uint32_t output_id)
     : name_{std::move(name)}
     , header_{std::move(header)}
@@ -798,6 +1937,7 @@ Function::Function(std::string&& name, HeaderParams&& header, InputParams&& inpu
     , input_id_{input_id}
     , output_id_{output_id}
 {
+    prepare_decoder();
 }
 
 Function::Function(std::string&& name, HeaderParams&& header, InputParams&& inputs, OutputParams&& outputs)
@@ -815,83 +1955,343 @@ Function::Function(std::string&& name, HeaderParams&& header, InputParams&& inpu
 {
 }
 
-auto Function::encode_input(FunctionCall& call) const -> td::Result<BuilderData>
+auto Function::with_fixed_layout(std::string&& name, HeaderParams&& header, InputParams&& inputs, OutputParams&& outputs, uint32_t input_id,
+                                 uint32_t output_id) -> td::Result<td::Ref<Function>>
 {
+    auto function = td::Ref<Function>{true, std::move(name), std::move(header), std::move(inputs), std::move(outputs), input_id, output_id};
+    TRY_STATUS(function.write().init_fixed_layout())
+    return function;
+}
+
+auto Function::encode_input(const FunctionCall& call) const -> td::Result<BuilderData>
+{
+    if (call.signing_key.not_null()) {
+        TRY_RESULT(header_slots, call.header_slots.has_value() ? td::Result<HeaderSlots>{*call.header_slots} : make_header_slots(call.header))
+        return encode_input(header_slots, call.inputs, call.internal, call.signing_key);
+    }
+    if (call.header_slots.has_value()) {
+        return encode_input(*call.header_slots, call.inputs, call.internal, call.private_key);
+    }
     return encode_input(call.header, call.inputs, call.internal, call.private_key);
 }
 
-auto Function::encode_input(const td::Ref<FunctionCall>& call) const -> td::Result<BuilderData>
+auto Function::encode_input(const td::Ref<FunctionCall>& call) const -> td::Result<BuilderData>
+{
+    return encode_input(*call);
+}
+
+auto Function::encode_input(const HeaderValues& header,
+                            const InputValues& inputs,
+                            bool internal,
+                            const std::optional<td::Ed25519::PrivateKey>& private_key) const -> td::Result<BuilderData>
+{
+    TRY_RESULT(header_slots, make_header_slots(header))
+    return encode_input(header_slots, inputs, internal, private_key);
+}
+
+auto Function::encode_input(const HeaderSlots& header,
+                            const InputValues& inputs,
+                            bool internal,
+                            const std::optional<td::Ed25519::PrivateKey>& private_key) const -> td::Result<BuilderData>
+{
+    TRY_RESULT(unsigned_call, create_unsigned_call(header, inputs, internal, private_key.has_value()))
+    auto [message, hash] = std::move(unsigned_call);
+
+    if (!internal) {
+        if (private_key.has_value()) {
+            TRY_RESULT(signature, private_key->sign(hash.as_slice()))
+            TRY_RESULT_ASSIGN(message, fill_signature(std::optional{std::move(signature)}, std::move(message)))
+        }
+        else {
+            TRY_RESULT_ASSIGN(message, fill_signature(std::nullopt, std::move(message)))
+        }
+    }
+
+    return message;
+}
+
+// hash of the cell which would be built from the rest of the slice
+static auto remaining_cell_hash(const vm::CellSlice& cursor) -> vm::CellHash
+{
+    unsigned char repr[MAX_CELL_REPR_SIZE];
+    const auto size = store_cell_repr(cursor, repr);
+    if (size == 0) {
+        vm::CellBuilder cb{};
+        CHECK(cb.append_cellslice_bool(cursor))
+        return cb.finalize()->get_hash();
+    }
+
+    unsigned char digest[32];
+    td::sha256(td::Slice{repr, size}, td::MutableSlice{digest, 32});
+    return vm::CellHash::from_slice(td::Slice{digest, 32});
+}
+
+auto Function::decode_input(vm::CellSlice& cursor, bool internal) const -> td::Result<DecodedInput>
+{
+    return decode_input(cursor, internal, DecodeLimits{});
+}
+
+auto Function::decode_input(vm::CellSlice& cursor, bool internal, const DecodeLimits& limits) const -> td::Result<DecodedInput>
+{
+    DecodeBudget budget{limits};
+    TRY_RESULT(result, decode_input_header(cursor, internal, budget))
+    if (result.function_id != input_id_) {
+        return td::Status::Error("invalid input_id");
+    }
+    TRY_RESULT_ASSIGN(result.inputs, decode_input_params(cursor, internal, budget))
+    return std::move(result);
+}
+
+auto Function::decode_input_header(vm::CellSlice& cursor, bool internal, DecodeBudget& budget) const -> td::Result<DecodedInput>
+{
+    // the signature always starts the root cell
+    auto layout = fixed_layout_ ? LayoutTracker{internal ? internal_cells_ : external_cells_, 0, 0} : LayoutTracker{};
+
+    DecodedInput result{};
+    if (!internal) {
+        bool has_signature;
+        if (!cursor.fetch_bool_to(has_signature)) {
+            return td::Status::Error("failed to fetch signature flag");
+        }
+        if (has_signature) {
+            td::SecureString signature{64};
+            if (!cursor.fetch_bytes(signature.as_mutable_slice().ubegin(), 64)) {
+                return td::Status::Error("failed to fetch signature");
+            }
+            result.signature = std::move(signature);
+        }
+        result.unsigned_hash = remaining_cell_hash(cursor);
+
+        for (const auto& param : header_) {
+            TRY_STATUS(layout.enter(cursor, budget))
+            TRY_RESULT(value, param->default_value())
+            if (auto status = value.write().decode(cursor, false, budget); status.is_error()) {
+                return budget.exceeded() ? budget.status() : std::move(status);
+            }
+            result.header.emplace(param->name(), std::move(value));
+            layout.leave();
+        }
+    }
+
+    TRY_STATUS(layout.enter(cursor, budget))
+    unsigned long long function_id;
+    if (!ensure_bits(cursor, 32, budget) || !cursor.fetch_ulong_bool(32, function_id)) {
+        return budget.exceeded() ? budget.status() : td::Status::Error("failed to fetch input_id");
+    }
+    result.function_id = static_cast<uint32_t>(function_id);
+    return std::move(result);
+}
+
+auto Function::encode_input(const HeaderSlots& header, const InputValues& inputs, bool internal, const td::Ref<SigningKey>& signing_key) const
+    -> td::Result<BuilderData>
+{
+    TRY_RESULT(unsigned_call, create_unsigned_call(header, inputs, internal, signing_key.not_null()))
+    auto [message, hash] = std::move(unsigned_call);
+
+    if (!internal) {
+        std::optional<td::SecureString> signature{};
+        if (signing_key.not_null()) {
+            TRY_RESULT_ASSIGN(signature, signing_key->sign(hash.as_slice()))
+        }
+        TRY_RESULT_ASSIGN(message, fill_signature(signature, std::move(message)))
+    }
+
+    return message;
+}
+
+auto Function::decode_output_id(vm::CellSlice& cursor) const -> td::Status
+{
+    unsigned long long output_id;
+    if (!cursor.fetch_ulong_bool(32, output_id)) {
+        return td::Status::Error("failed to fetch output_id");
+    }
+
+    if (output_id != output_id_) {
+        return td::Status::Error("invalid output_id");
+    }
+    return td::Status::OK();
+}
+
+auto Function::decode_output(SliceData&& data) const -> td::Result<std::vector<ValueRef>>
+{
+    return decode_output(data.write());
+}
+
+auto Function::decode_output(vm::CellSlice& cursor, const DecodeLimits& limits) const -> td::Result<std::vector<ValueRef>>
+{
+    TRY_STATUS(decode_output_id(cursor))
+
+    DecodeBudget budget{limits};
+    return decode_params(cursor, budget);
+}
+
+auto Function::decode_output(vm::CellSlice& cursor) const -> td::Result<std::vector<ValueRef>>
+{
+    return decode_output(cursor, DecodeLimits{});
+}
+
+auto Function::decode_output_if_changed(const td::Ref<vm::Cell>& body, const std::optional<vm::CellHash>& previous) const -> td::Result<OutputSnapshot>
+{
+    OutputSnapshot snapshot{};
+    if (body.is_null()) {
+        // zero hash stands for no output, which is only valid without outputs
+        if (!outputs_.empty()) {
+            return td::Status::Error("no output message");
+        }
+        snapshot.changed = !previous.has_value() || !previous->is_zero();
+        return snapshot;
+    }
+
+    snapshot.body_hash = body->get_hash();
+    if (previous.has_value() && *previous == snapshot.body_hash) {
+        snapshot.changed = false;
+        return snapshot;
+    }
+
+    auto cursor = vm::load_cell_slice(body);
+    TRY_RESULT_ASSIGN(snapshot.values, decode_output(cursor))
+    return snapshot;
+}
+
+static auto static_bit_len(const ParamRef& param) -> uint32_t
 {
-    return encode_input(call->header, call->inputs, call->internal, call->private_key);
+    switch (param->type()) {
+        case ParamType::Uint:
+        case ParamType::Int:
+            return static_cast<uint32_t>(param->bit_len());
+        case ParamType::Bool:
+            return 1;
+        case ParamType::Address:
+            return STD_ADDRESS_BIT_LENGTH;
+        case ParamType::Time:
+            return 64;
+        case ParamType::Expire:
+            return 32;
+        default:
+            return 0;
+    }
 }
 
-auto Function::encode_input(const HeaderValues& header,
-                            const InputValues& inputs,
-                            bool internal,
-                            const std::optional<td::Ed25519::PrivateKey>& private_key) const -> td::Result<BuilderData>
+static auto decode_static_value(BitReader& reader, const ParamRef& param) -> td::Result<ValueRef>
 {
-    TRY_RESULT(unsigned_call, create_unsigned_call(header, inputs, internal, private_key.has_value()))
-    auto [message, hash] = std::move(unsigned_call);
-
-    if (!internal) {
-        if (private_key.has_value()) {
-            TRY_RESULT(signature, private_key->sign(hash.as_slice()))
-            TRY_RESULT_ASSIGN(message, fill_signature(std::optional{std::move(signature)}, std::move(message)))
+    ValueRef result{};
+    TRY_STATUS(read_inline_value(reader, *param, [&](const auto& value) {
+        using V = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<V, bool>) {
+            result = ValueRef{ValueBool{param, value}};
         }
-        else {
-            TRY_RESULT_ASSIGN(message, fill_signature(std::nullopt, std::move(message)))
+        else if constexpr (std::is_same_v<V, block::StdAddress>) {
+            result = ValueRef{ValueAddress{param, value}};
         }
+        else if constexpr (std::is_same_v<V, uint32_t>) {
+            result = ValueRef{ValueExpire{param, value}};
+        }
+        else if constexpr (std::is_same_v<V, uint64_t>) {
+            result = param->type() == ParamType::Time ? ValueRef{ValueTime{param, value}} : ValueRef{ValueInt{param, to_bigint(value)}};
+        }
+        else if constexpr (std::is_same_v<V, int64_t>) {
+            result = ValueRef{ValueInt{param, to_bigint(value)}};
+        }
+        else if constexpr (std::is_same_v<V, td::BigInt256>) {
+            result = ValueRef{ValueInt{param, value}};
+        }
+    }))
+    if (result.is_null()) {
+        return td::Status::Error("param is not static");
     }
-
-    return message;
+    return result;
 }
 
-auto Function::decode_output(SliceData&& data) const -> td::Result<std::vector<ValueRef>>
+auto Function::decode_params(SliceData&& data) const -> td::Result<std::vector<ValueRef>>
 {
-    unsigned long long output_id;
-    if (!data.write().fetch_ulong_bool(32, output_id)) {
-        return td::Status::Error("failed to fetch output_id");
-    }
-
-    if (output_id != output_id_) {
-        return td::Status::Error("invalid output_id");
-    }
+    return decode_params(data.write());
+}
 
-    return decode_params(std::move(data));
+auto Function::decode_params(vm::CellSlice& cursor) const -> td::Result<std::vector<ValueRef>>
+{
+    DecodeBudget budget{};
+    return decode_params(cursor, budget);
 }
 
-auto Function::decode_params(SliceData&& cursor) const -> td::Result<std::vector<ValueRef>>
+static auto decode_values(vm::CellSlice& cursor, const std::vector<ParamRef>& params, const std::vector<uint32_t>& run_bits, DecodeBudget& budget,
+                          LayoutTracker layout = {}) -> td::Result<std::vector<ValueRef>>
 {
     std::vector<ValueRef> results;
+    results.reserve(params.size());
+
+    for (size_t i = 0; i < params.size();) {
+        TRY_STATUS(layout.enter(cursor, budget))
+
+        // decode the whole run of static-width values at once if it fits into the current cell
+        if (run_bits[i] > 0 && ensure_bits(cursor, run_bits[i], budget)) {
+            BitReader reader{cursor};
+            for (; i < params.size() && run_bits[i] > 0; ++i) {
+                TRY_RESULT(value, decode_static_value(reader, params[i]))
+                results.emplace_back(std::move(value));
+                layout.leave();
+            }
+            CHECK(cursor.advance(reader.consumed()))
+            continue;
+        }
 
-    for (size_t i = 0; i < outputs_.size(); ++i) {
-        const auto last = i + 1 == outputs_.size();
-        TRY_RESULT(default_value, outputs_[i]->default_value())
-        TRY_RESULT_ASSIGN(cursor, default_value.write().deserialize(std::move(cursor), last))
+        const auto last = i + 1 == params.size();
+        TRY_RESULT(default_value, params[i]->default_value())
+        if (auto status = default_value.write().decode(cursor, last, budget); status.is_error()) {
+            return budget.exceeded() ? budget.status() : std::move(status);
+        }
         results.emplace_back(std::move(default_value));
+        layout.leave();
+        ++i;
     }
 
-    if (!cursor->empty_ext()) {
+    if (!cursor.empty_ext()) {
         return td::Status::Error("incomplete deserialization");
     }
 
     return std::move(results);
 }
 
+auto Function::decode_params(vm::CellSlice& cursor, DecodeBudget& budget) const -> td::Result<std::vector<ValueRef>>
+{
+    return decode_values(cursor, outputs_, output_run_bits_, budget);
+}
+
+auto Function::decode_input_params(vm::CellSlice& cursor, bool internal, DecodeBudget& budget) const -> td::Result<std::vector<ValueRef>>
+{
+    if (!fixed_layout_) {
+        return decode_values(cursor, inputs_, input_run_bits_, budget);
+    }
+    // inputs follow the function id
+    const auto& cells = internal ? internal_cells_ : external_cells_;
+    const auto first_input = internal ? 1 : header_.size() + 1;
+    return decode_values(cursor, inputs_, input_run_bits_, budget, LayoutTracker{cells, first_input, cells[first_input - 1].second});
+}
+
 auto Function::encode_header(const HeaderValues& header, bool internal) const -> td::Result<std::vector<BuilderData>>
+{
+    TRY_RESULT(header_slots, make_header_slots(header))
+    return encode_header(header_slots, internal);
+}
+
+// value of the header param at the position, null if it is not set
+static auto find_header_value(const HeaderParams& params, const HeaderSlots& header, size_t i) -> ValueRef
+{
+    if (i < MAX_HEADER_SLOTS) {
+        return header.values[i];
+    }
+    auto it = header.overflow.find(params[i]->name());
+    return it != header.overflow.end() ? it->second : ValueRef{};
+}
+
+auto Function::encode_header(const HeaderSlots& header, bool internal) const -> td::Result<std::vector<BuilderData>>
 {
     std::vector<BuilderData> result{};
     if (!internal) {
-        for (const auto& param : header_) {
-            auto it = header.find(param->name());
-            if (it == header.end()) {
-                TRY_RESULT(default_value, param->default_value());
-                TRY_RESULT(builder_data, default_value->serialize());
-                TRY_RESULT(cell, pack_cells_into_chain(std::move(builder_data)))
-                result.emplace_back(std::move(cell));
-            }
-            else {
-                const auto& value = it->second;
+        result.reserve(header_.size() + 1);
+        for (size_t i = 0; i < header_.size(); ++i) {
+            const auto& param = header_[i];
+            const auto value = find_header_value(header_, header, i);
+            if (value.not_null()) {
                 if (!value->check_type(param)) {
                     return td::Status::Error("wrong parameter type");
                 }
@@ -899,7 +2299,34 @@ auto Function::encode_header(const HeaderValues& header, bool internal) const ->
                 TRY_RESULT(builder_data, value->serialize())
                 TRY_RESULT(cell, pack_cells_into_chain(std::move(builder_data)))
                 result.emplace_back(std::move(cell));
+                continue;
+            }
+
+            vm::CellBuilder cb{};
+            switch (param->type()) {
+                case ParamType::Time:
+                    CHECK(cb.store_long_bool(header.time.has_value() ? *header.time : now_ms(), 64))
+                    break;
+                case ParamType::Expire:
+                    CHECK(cb.store_long_bool(header.expire.value_or(std::numeric_limits<uint32_t>::max()), 32))
+                    break;
+                case ParamType::PublicKey:
+                    if (header.pubkey.has_value()) {
+                        CHECK(cb.store_long_bool(1, 1) && cb.store_bits_bool(*header.pubkey))
+                    }
+                    else {
+                        CHECK(cb.store_long_bool(0, 1))
+                    }
+                    break;
+                default: {
+                    TRY_RESULT(default_value, param->default_value())
+                    TRY_RESULT(builder_data, default_value->serialize())
+                    TRY_RESULT(cell, pack_cells_into_chain(std::move(builder_data)))
+                    result.emplace_back(std::move(cell));
+                    continue;
+                }
             }
+            result.emplace_back(cb.finalize());
         }
     }
 
@@ -909,8 +2336,144 @@ auto Function::encode_header(const HeaderValues& header, bool internal) const ->
     return result;
 }
 
+auto Function::header_slot(const std::string& name) const -> td::Result<size_t>
+{
+    for (size_t i = 0; i < header_.size(); ++i) {
+        if (header_[i]->name() == name) {
+            if (i >= MAX_HEADER_SLOTS) {
+                return td::Status::Error("header param has no slot");
+            }
+            return i;
+        }
+    }
+    return td::Status::Error("header param not found");
+}
+
+auto Function::make_header_slots(const HeaderValues& header) const -> td::Result<HeaderSlots>
+{
+    HeaderSlots result{};
+    if (header.empty()) {
+        return result;
+    }
+
+    for (size_t i = 0; i < header_.size(); ++i) {
+        auto it = header.find(header_[i]->name());
+        if (it == header.end()) {
+            continue;
+        }
+        if (i < MAX_HEADER_SLOTS) {
+            result.values[i] = it->second;
+        }
+        else {
+            result.overflow.emplace(it->first, it->second);
+        }
+    }
+    return result;
+}
+
 auto Function::create_unsigned_call(const HeaderValues& header, const InputValues& inputs, bool internal, bool reserve_sign) const
     -> td::Result<std::pair<BuilderData, vm::CellHash>>
+{
+    TRY_RESULT(header_slots, make_header_slots(header))
+    return create_unsigned_call(header_slots, inputs, internal, reserve_sign);
+}
+
+auto Function::create_unsigned_call(const HeaderSlots& header, const InputValues& inputs, bool internal, bool reserve_sign) const
+    -> td::Result<std::pair<BuilderData, vm::CellHash>>
+{
+    TRY_RESULT(packed, pack_call(header, inputs, internal, reserve_sign))
+    auto [result, remove_bits] = std::move(packed);
+
+    if (!internal && remove_bits > 0) {
+        auto slice = vm::load_cell_slice(result);
+        vm::CellBuilder cb{};
+        CHECK(slice.advance(remove_bits) && cb.append_cellslice_bool(slice));
+        result = cb.finalize();
+    }
+
+    const auto hash = result->get_hash();
+
+    return std::make_pair(std::move(result), hash);
+}
+
+auto Function::create_unsigned_calls(const std::vector<td::Ref<FunctionCall>>& calls, bool reserve_sign) const -> std::vector<td::Result<UnsignedCall>>
+{
+    std::vector<td::Result<UnsignedCall>> result{};
+    result.reserve(calls.size());
+
+    // chain cells are hashed by the vm while they are built. only roots of external calls without signature
+    // are left, they are hashed from their representation in one pass and cells for them are never built
+    CellHashBatch batch{};
+    batch.reserve(calls.size());
+    std::vector<size_t> hash_indices(calls.size(), 0);
+
+    for (size_t i = 0; i < calls.size(); ++i) {
+        const auto& call = *calls[i];
+        // same layout as `encode_input` produces for this call
+        const auto reserve = reserve_sign || call.signing_key.not_null() || call.private_key.has_value();
+        auto packed = [&]() -> td::Result<std::pair<BuilderData, size_t>> {
+            if (call.header_slots.has_value()) {
+                return pack_call(*call.header_slots, call.inputs, call.internal, reserve);
+            }
+            TRY_RESULT(header_slots, make_header_slots(call.header))
+            return pack_call(header_slots, call.inputs, call.internal, reserve);
+        }();
+        if (packed.is_error()) {
+            result.emplace_back(packed.move_as_error());
+            continue;
+        }
+
+        auto [body, remove_bits] = packed.move_as_ok();
+        if (call.internal) {
+            const auto hash = body->get_hash();
+            result.emplace_back(UnsignedCall{std::move(body), hash});
+            continue;
+        }
+
+        auto cs = vm::load_cell_slice(body);
+        CHECK(cs.advance(remove_bits))
+        hash_indices[i] = batch.add(cs);
+        result.emplace_back(UnsignedCall{std::move(body), vm::CellHash{}});
+    }
+
+    const auto hashes = batch.compute();
+    for (size_t i = 0; i < calls.size(); ++i) {
+        if (result[i].is_ok() && !calls[i]->internal) {
+            result[i].ok_ref().hash = hashes[hash_indices[i]];
+        }
+    }
+    return result;
+}
+
+auto Function::encode_inputs(const std::vector<td::Ref<FunctionCall>>& calls) const -> std::vector<td::Result<BuilderData>>
+{
+    auto unsigned_calls = create_unsigned_calls(calls);
+
+    std::vector<td::Result<BuilderData>> result{};
+    result.reserve(calls.size());
+    for (size_t i = 0; i < calls.size(); ++i) {
+        const auto& call = *calls[i];
+        result.emplace_back([&]() -> td::Result<BuilderData> {
+            TRY_RESULT(unsigned_call, std::move(unsigned_calls[i]))
+            if (call.internal) {
+                return std::move(unsigned_call.body);
+            }
+
+            std::optional<td::SecureString> signature{};
+            if (call.signing_key.not_null()) {
+                TRY_RESULT_ASSIGN(signature, call.signing_key->sign(unsigned_call.hash.as_slice()))
+            }
+            else if (call.private_key.has_value()) {
+                TRY_RESULT_ASSIGN(signature, call.private_key->sign(unsigned_call.hash.as_slice()))
+            }
+            return fill_signature(signature, unsigned_call);
+        }());
+    }
+    return result;
+}
+
+auto Function::pack_call(const HeaderSlots& header, const InputValues& inputs, bool internal, bool reserve_sign) const
+    -> td::Result<std::pair<BuilderData, size_t>>
 {
     if (!check_params(inputs, inputs_)) {
         return td::Status::Error("invalid inputs");
@@ -939,18 +2502,79 @@ auto Function::create_unsigned_call(const HeaderValues& header, const InputValue
         cells.insert(cells.end(), builder_data.begin(), builder_data.end());
     }
 
-    TRY_RESULT(result, pack_cells_into_chain(std::move(cells)))
+    BuilderData result{};
+    if (fixed_layout_) {
+        TRY_RESULT_ASSIGN(result, pack_cells_by_layout(std::move(cells), internal ? internal_layout_ : external_layout_))
+    }
+    else {
+        TRY_RESULT_ASSIGN(result, pack_cells_into_chain(std::move(cells)))
+    }
 
-    if (!internal && remove_bits > 0) {
-        auto slice = vm::load_cell_slice(result);
-        vm::CellBuilder cb{};
-        CHECK(slice.advance(remove_bits) && cb.append_cellslice_bool(slice));
-        result = cb.finalize();
+    return std::make_pair(std::move(result), internal ? 0 : remove_bits);
+}
+
+static auto compute_run_bits(const std::vector<ParamRef>& params) -> std::vector<uint32_t>
+{
+    std::vector<uint32_t> result(params.size(), 0);
+    uint32_t run_bits = 0;
+    for (size_t i = params.size(); i > 0; --i) {
+        const auto bits = static_bit_len(params[i - 1]);
+        run_bits = bits == 0 ? 0 : run_bits + bits;
+        result[i - 1] = run_bits;
     }
+    return result;
+}
 
-    const auto hash = result->get_hash();
+auto Function::prepare_decoder() -> void
+{
+    input_run_bits_ = compute_run_bits(inputs_);
+    output_run_bits_ = compute_run_bits(outputs_);
+}
 
-    return std::make_pair(std::move(result), hash);
+// cells of the first and the last leaf of each item, `items` holds numbers of leaves starting from `leaf`
+static auto compute_param_cells(const CellLayout& layout, const std::vector<size_t>& items, size_t leaf) -> ParamCells
+{
+    ParamCells result{};
+    result.reserve(items.size());
+    for (const auto count : items) {
+        // empty tuples have no leaves and stay in the cell of the previous one
+        const auto first = count == 0 ? layout[leaf - 1] : layout[leaf];
+        leaf += count;
+        result.emplace_back(first, layout[leaf - 1]);
+    }
+    return result;
+}
+
+auto Function::init_fixed_layout() -> td::Status
+{
+    constexpr size_t signature_bits = 1 + 512;
+    constexpr size_t function_id_bits = 32;
+
+    const auto append_items = [](const std::vector<ParamRef>& params, LeafSizes& sizes, std::vector<size_t>& items) {
+        for (const auto& param : params) {
+            const auto before = sizes.size();
+            append_leaf_sizes(param, sizes);
+            items.emplace_back(sizes.size() - before);
+        }
+    };
+
+    LeafSizes external_sizes{{signature_bits, 0}};
+    std::vector<size_t> external_items{};
+    append_items(header_, external_sizes, external_items);
+    external_sizes.emplace_back(function_id_bits, 0);
+    external_items.emplace_back(1);
+    append_items(inputs_, external_sizes, external_items);
+
+    LeafSizes internal_sizes{{function_id_bits, 0}};
+    std::vector<size_t> internal_items{1};
+    append_items(inputs_, internal_sizes, internal_items);
+
+    TRY_RESULT_ASSIGN(external_layout_, compute_fixed_layout(external_sizes))
+    TRY_RESULT_ASSIGN(internal_layout_, compute_fixed_layout(internal_sizes))
+    external_cells_ = compute_param_cells(external_layout_, external_items, 1);
+    internal_cells_ = compute_param_cells(internal_layout_, internal_items, 0);
+    fixed_layout_ = true;
+    return td::Status::OK();
 }
 
 auto Function::make_copy() const -> Function*
@@ -959,7 +2583,65 @@ auto Function::make_copy() const -> Function*
     auto header = header_;
     auto inputs = inputs_;
     auto outputs = outputs_;
-    return new Function{std::move(name), std::move(header), std::move(inputs), std::move(outputs), input_id_, output_id_};
+    auto* result = new Function{std::move(name), std::move(header), std::move(inputs), std::move(outputs), input_id_, output_id_};
+    result->fixed_layout_ = fixed_layout_;
+    result->external_layout_ = external_layout_;
+    result->internal_layout_ = internal_layout_;
+    result->external_cells_ = external_cells_;
+    result->internal_cells_ = internal_cells_;
+    return result;
+}
+
+Contract::Contract(std::string&& name, std::vector<td::Ref<Function>>&& functions)
+    : name_{std::move(name)}
+    , functions_{std::move(functions)}
+{
+}
+
+auto Contract::find_function(const std::string& name) const -> td::Result<td::Ref<Function>>
+{
+    for (const auto& function : functions_) {
+        if (function->name() == name) {
+            return function;
+        }
+    }
+    return td::Status::Error(PSLICE() << "function " << name << " not found");
+}
+
+auto Contract::find_function_by_input_id(uint32_t input_id) const -> td::Result<td::Ref<Function>>
+{
+    for (const auto& function : functions_) {
+        if (function->input_id() == input_id) {
+            return function;
+        }
+    }
+    return td::Status::Error(PSLICE() << "function with input id " << input_id << " not found");
+}
+
+auto Contract::decode_input(vm::CellSlice& cursor, bool internal) const -> td::Result<std::pair<td::Ref<Function>, DecodedInput>>
+{
+    return decode_input(cursor, internal, DecodeLimits{});
+}
+
+auto Contract::decode_input(vm::CellSlice& cursor, bool internal, const DecodeLimits& limits) const
+    -> td::Result<std::pair<td::Ref<Function>, DecodedInput>>
+{
+    if (functions_.empty()) {
+        return td::Status::Error("contract has no functions");
+    }
+
+    DecodeBudget budget{limits};
+    TRY_RESULT(result, functions_.front()->decode_input_header(cursor, internal, budget))
+    TRY_RESULT(function, find_function_by_input_id(result.function_id))
+    TRY_RESULT_ASSIGN(result.inputs, function->decode_input_params(cursor, internal, budget))
+    return std::make_pair(std::move(function), std::move(result));
+}
+
+auto Contract::make_copy() const -> Contract*
+{
+    auto name = name_;
+    auto functions = functions_;
+    return new Contract{std::move(name), std::move(functions)};
 }
 
 // smc stuff
@@ -984,7 +2666,7 @@ static auto unpack_internal_address_opt(vm::CellSlice& cs, std::optional<block::
     return success;
 }
 
-static auto unpack_message(td::Ref<vm::Cell>& msg) -> td::Result<td::Ref<vm::Cell>>
+auto unpack_message(td::Ref<vm::Cell>& msg) -> td::Result<td::Ref<vm::Cell>>
 {
     if (msg.is_null()) {
         return td::Status::Error("message not found");
@@ -1059,149 +2741,239 @@ static auto prepare_vm_c7(ton::UnixTime now, ton::LogicalTime lt, td::Ref<vm::Ce
     return vm::make_tuple_ref(std::move(tuple));
 }
 
-auto run_smc_method(AccountStateInfo&& account, td::Ref<Function>&& function, td::Ref<FunctionCall>&& function_call) -> td::Result<std::vector<ValueRef>>
+namespace
 {
-    try {
-        const auto& info = account.state_details_info;
-
-        if (info.root.is_null()) {
-            LOG(ERROR) << "account state of " << account.workchain << ":" << account.addr.to_hex() << " is empty";
-            return td::Status::Error(PSLICE() << "account state of " << account.workchain << ":" << account.addr.to_hex() << " is empty");
-        }
-
-        // unpack account state
-        block::gen::Account::Record_account acc;
-        block::gen::AccountStorage::Record store;
-        block::CurrencyCollection balance;
-        if (!(tlb::unpack_cell(info.root, acc) && tlb::csr_unpack(acc.storage, store) && balance.validate_unpack(store.balance))) {
-            LOG(ERROR) << "error unpacking account state";
-            return td::Status::Error("error unpacking account state");
-        }
+struct MethodResult {
+    vm::CellHash state_hash{};
+    vm::CellHash balance_hash{};
+    vm::CellHash input_hash{};
+    // false if the inputs matched `previous` and the method was not run
+    bool executed{};
+    // body of the first external outbound message, null if there is none
+    td::Ref<vm::Cell> body{};
+};
 
-        // validate account state
-        switch (block::gen::t_AccountState.get_tag(*store.state)) {
-            case block::gen::AccountState::account_uninit:
-                LOG(ERROR) << "account " << account.workchain << ":" << account.addr.to_hex() << " not initialized yet (cannot run any methods)";
-                return td::Status::Error(PSLICE()
-                                         << "account " << account.workchain << ":" << account.addr.to_hex() << " not initialized yet (cannot run any methods)");
-            case block::gen::AccountState::account_frozen:
-                LOG(ERROR) << "account " << account.workchain << ":" << account.addr.to_hex() << " frozen (cannot run any methods)";
-                return td::Status::Error(PSLICE() << "account " << account.workchain << ":" << account.addr.to_hex() << " frozen (cannot run any methods)");
-            default:
-                break;
-        }
+// loading special, library or pruned cells throws, both while running the method and while decoding its output
+template <typename F>
+auto guard_vm_errors(F&& f) -> decltype(f())
+{
+    try {
+        return f();
+    }
+    catch (vm::VmVirtError& err) {
+        LOG(ERROR) << "virtualization error while parsing runSmcMethod result: " << err.get_msg();
+        return td::Status::Error(PSLICE() << "virtualization error while parsing runSmcMethod result: " << err.get_msg());
+    }
+    catch (vm::VmError& err) {
+        LOG(ERROR) << "error while parsing runSmcMethod result: " << err.get_msg();
+        return td::Status::Error(PSLICE() << "error while parsing runSmcMethod result: " << err.get_msg());
+    }
+    catch (vm::VmFatal& err) {
+        LOG(ERROR) << "error while running VM";
+        return td::Status::Error("Fatal VM error");
+    }
+}
 
-        CHECK(store.state.write().fetch_ulong(1) == 1)  // account_init$1 _:StateInit = AccountState;
-        block::gen::StateInit::Record state_init;
-        CHECK(tlb::csr_unpack(store.state, state_init));
+// runs the method unless everything it can read is the same as for `previous`.
+// must be called under `guard_vm_errors`
+auto execute_smc_method(AccountStateInfo& account,
+                        const Function& function,
+                        td::Ref<FunctionCall>&& function_call,
+                        const OutputSnapshot* previous,
+                        ExecutionProfiler* profiler) -> td::Result<MethodResult>
+{
+    const auto& info = account.state_details_info;
 
-        // encode message and it's body
-        TRY_RESULT(message_body, function->encode_input(function_call));
+    if (info.root.is_null()) {
+        LOG(ERROR) << "account state of " << account.workchain << ":" << account.addr.to_hex() << " is empty";
+        return td::Status::Error(PSLICE() << "account state of " << account.workchain << ":" << account.addr.to_hex() << " is empty");
+    }
 
-        td::Ref<vm::Cell> message_body_ref;
-        if (function_call->body_as_ref) {
-            message_body_ref = vm::CellBuilder{}.store_ref(message_body).finalize();
-        }
-        else {
-            message_body_ref = message_body;
-        }
-        auto message = ton::GenericAccount::create_ext_message(block::StdAddress{account.workchain, account.addr}, {}, std::move(message_body_ref));
+    // unpack account state
+    block::gen::Account::Record_account acc;
+    block::gen::AccountStorage::Record store;
+    block::CurrencyCollection balance;
+    if (!(tlb::unpack_cell(info.root, acc) && tlb::csr_unpack(acc.storage, store) && balance.validate_unpack(store.balance))) {
+        LOG(ERROR) << "error unpacking account state";
+        return td::Status::Error("error unpacking account state");
+    }
 
-        auto message_body_cs = vm::load_cell_slice_ref(message_body);
+    // validate account state
+    switch (block::gen::t_AccountState.get_tag(*store.state)) {
+        case block::gen::AccountState::account_uninit:
+            LOG(ERROR) << "account " << account.workchain << ":" << account.addr.to_hex() << " not initialized yet (cannot run any methods)";
+            return td::Status::Error(PSLICE()
+                                     << "account " << account.workchain << ":" << account.addr.to_hex() << " not initialized yet (cannot run any methods)");
+        case block::gen::AccountState::account_frozen:
+            LOG(ERROR) << "account " << account.workchain << ":" << account.addr.to_hex() << " frozen (cannot run any methods)";
+            return td::Status::Error(PSLICE() << "account " << account.workchain << ":" << account.addr.to_hex() << " frozen (cannot run any methods)");
+        default:
+            break;
+    }
 
-        // fill stack
-        auto stack = td::make_ref<vm::Stack>();
-        stack.write().push(vm::StackEntry{balance.grams});
-        stack.write().push_smallint(0);
-        stack.write().push_cell(message);
-        stack.write().push_cellslice(message_body_cs);
-        stack.write().push_smallint(-1);
+    CHECK(store.state.write().fetch_ulong(1) == 1)  // account_init$1 _:StateInit = AccountState;
 
-        // create vm
-        LOG(DEBUG) << "creating VM";
+    MethodResult result{};
+    result.state_hash = vm::CellBuilder{}.append_cellslice(store.state).finalize()->get_hash();
+    result.balance_hash = vm::CellBuilder{}.append_cellslice(store.balance).finalize()->get_hash();
 
-        vm::VmState vm{state_init.code->prefetch_ref(),
-                       std::move(stack),
-                       vm::GasLimits{1'000'000'000},
-                       /* flags */ 1,
-                       state_init.data->prefetch_ref(),
-                       vm::VmLog{}};
+    block::gen::StateInit::Record state_init;
+    CHECK(tlb::csr_unpack(store.state, state_init));
 
-        // initialize registers with SmartContractInfo
-        auto my_addr = td::make_ref<vm::CellSlice>(acc.addr->clone());
-        vm.set_c7(prepare_vm_c7(info.gen_utime, info.gen_lt, my_addr, balance));
+    // encode message and it's body
+    TRY_RESULT(message_body, function.encode_input(function_call));
 
-        // execute
-        LOG(INFO) << "starting VM to run method of smart contract " << account.workchain << ":" << account.addr.to_hex();
+    td::Ref<vm::Cell> message_body_ref;
+    if (function_call->body_as_ref) {
+        message_body_ref = vm::CellBuilder{}.store_ref(message_body).finalize();
+    }
+    else {
+        message_body_ref = message_body;
+    }
+    auto message = ton::GenericAccount::create_ext_message(block::StdAddress{account.workchain, account.addr}, {}, std::move(message_body_ref));
+    // the message holds the account address together with the function id and encoded inputs
+    result.input_hash = message->get_hash();
 
-        int exit_code;
-        try {
-            exit_code = ~vm.run();
-        }
-        catch (vm::VmVirtError& err) {
-            LOG(ERROR) << "virtualization error while running VM to locally compute runSmcMethod result: " << err.get_msg();
-            return td::Status::Error(PSLICE() << "virtualization error while running VM to locally compute runSmcMethod result: " << err.get_msg());
-        }
-        catch (vm::VmError& err) {
-            LOG(ERROR) << "error while running VM to locally compute runSmcMethod result: " << err.get_msg();
-            return td::Status::Error(PSLICE() << "error while running VM to locally compute runSmcMethod result: " << err.get_msg());
-        }
-        catch (vm::VmFatal& err) {
-            LOG(ERROR) << "error while running VM";
-            return td::Status::Error("Fatal VM error");
-        }
+    // besides the message the getter reads code, data and balance. time and random seed of c7 are not compared
+    if (previous != nullptr && previous->function_id == function.input_id() && previous->state_hash == result.state_hash &&
+        previous->balance_hash == result.balance_hash && previous->input_hash == result.input_hash) {
+        return result;
+    }
+    result.executed = true;
 
-        LOG(DEBUG) << "VM terminated with exit code " << exit_code;
+    auto message_body_cs = vm::load_cell_slice_ref(message_body);
 
-        if (exit_code != 0) {
-            LOG(ERROR) << "VM terminated with error code " << exit_code;
-            return td::Status::Error(PSLICE() << "VM terminated with non-zero exit code " << exit_code);
-        }
+    // fill stack
+    auto stack = td::make_ref<vm::Stack>();
+    stack.write().push(vm::StackEntry{balance.grams});
+    stack.write().push_smallint(0);
+    stack.write().push_cell(message);
+    stack.write().push_cellslice(message_body_cs);
+    stack.write().push_smallint(-1);
 
-        // process output messages
-        if (vm.get_committed_state().committed) {
-            auto actions_cs = vm::load_cell_slice(vm.get_committed_state().c5);
+    // create vm
+    LOG(DEBUG) << "creating VM";
 
-            while (actions_cs.size_refs()) {
-                td::Ref<vm::Cell> next;
-                CHECK(actions_cs.fetch_ref_to(next))
+    constexpr int64_t gas_limit = 1'000'000'000;
 
-                unsigned long long magic;
-                if (actions_cs.fetch_ulong_bool(32, magic) && magic == 0x0ec3c86du && actions_cs.size_refs() == 1) {
-                    td::Ref<vm::Cell> msg;
-                    CHECK(actions_cs.fetch_ref_to(msg))
-                    auto parsed_body = unpack_message(msg).move_as_ok();
-                    auto parsed_body_cs = vm::load_cell_slice_ref(parsed_body);
+    std::optional<ExecutionTracer> tracer{};
+    if (profiler != nullptr) {
+        tracer.emplace(gas_limit);
+    }
 
-                    std::ostringstream mss;
-                    vm::load_cell_slice(parsed_body).print_rec(mss);
-                    LOG(DEBUG) << "Processing message: " << mss.str();
+    vm::VmState vm{state_init.code->prefetch_ref(),
+                   std::move(stack),
+                   vm::GasLimits{gas_limit},
+                   /* flags */ 1,
+                   state_init.data->prefetch_ref(),
+                   tracer.has_value() ? tracer->vm_log() : vm::VmLog{}};
 
-                    TRY_RESULT(result, function->decode_output(std::move(parsed_body_cs)));
-                    return result;
-                }
-                else {
-                    LOG(ERROR) << "Failed to read message";
-                }
+    // initialize registers with SmartContractInfo
+    auto my_addr = td::make_ref<vm::CellSlice>(acc.addr->clone());
+    vm.set_c7(prepare_vm_c7(info.gen_utime, info.gen_lt, my_addr, balance));
 
-                actions_cs = vm::load_cell_slice(next);
-            }
-        }
+    // execute
+    LOG(INFO) << "starting VM to run method of smart contract " << account.workchain << ":" << account.addr.to_hex();
 
-        return std::vector<ValueRef>{};
+    int exit_code;
+    try {
+        exit_code = ~vm.run();
     }
     catch (vm::VmVirtError& err) {
-        LOG(ERROR) << "virtualization error while parsing runSmcMethod result: " << err.get_msg();
-        return td::Status::Error(PSLICE() << "virtualization error while parsing runSmcMethod result: " << err.get_msg());
+        LOG(ERROR) << "virtualization error while running VM to locally compute runSmcMethod result: " << err.get_msg();
+        return td::Status::Error(PSLICE() << "virtualization error while running VM to locally compute runSmcMethod result: " << err.get_msg());
     }
     catch (vm::VmError& err) {
-        LOG(ERROR) << "error while parsing runSmcMethod result: " << err.get_msg();
-        return td::Status::Error(PSLICE() << "error while parsing runSmcMethod result: " << err.get_msg());
+        LOG(ERROR) << "error while running VM to locally compute runSmcMethod result: " << err.get_msg();
+        return td::Status::Error(PSLICE() << "error while running VM to locally compute runSmcMethod result: " << err.get_msg());
     }
     catch (vm::VmFatal& err) {
         LOG(ERROR) << "error while running VM";
         return td::Status::Error("Fatal VM error");
     }
+
+    LOG(DEBUG) << "VM terminated with exit code " << exit_code;
+
+    if (tracer.has_value()) {
+        profiler->record(std::to_string(account.workchain) + ":" + account.addr.to_hex(), function.name(), tracer->finish(vm.gas_consumed()));
+    }
+
+    if (exit_code != 0) {
+        LOG(ERROR) << "VM terminated with error code " << exit_code;
+        return td::Status::Error(PSLICE() << "VM terminated with non-zero exit code " << exit_code);
+    }
+
+    // process output messages
+    if (vm.get_committed_state().committed) {
+        auto actions_cs = vm::load_cell_slice(vm.get_committed_state().c5);
+
+        while (actions_cs.size_refs()) {
+            td::Ref<vm::Cell> next;
+            CHECK(actions_cs.fetch_ref_to(next))
+
+            unsigned long long magic;
+            if (actions_cs.fetch_ulong_bool(32, magic) && magic == 0x0ec3c86du && actions_cs.size_refs() == 1) {
+                td::Ref<vm::Cell> msg;
+                CHECK(actions_cs.fetch_ref_to(msg))
+                auto parsed_body = unpack_message(msg).move_as_ok();
+
+                std::ostringstream mss;
+                vm::load_cell_slice(parsed_body).print_rec(mss);
+                LOG(DEBUG) << "Processing message: " << mss.str();
+
+                result.body = std::move(parsed_body);
+                return result;
+            }
+            else {
+                LOG(ERROR) << "Failed to read message";
+            }
+
+            actions_cs = vm::load_cell_slice(next);
+        }
+    }
+
+    return result;
+}
+
+}  // namespace
+
+auto run_smc_method(AccountStateInfo&& account, td::Ref<Function>&& function, td::Ref<FunctionCall>&& function_call, ExecutionProfiler* profiler)
+    -> td::Result<std::vector<ValueRef>>
+{
+    return guard_vm_errors([&]() -> td::Result<std::vector<ValueRef>> {
+        TRY_RESULT(result, execute_smc_method(account, *function, std::move(function_call), nullptr, profiler))
+        if (result.body.is_null()) {
+            return std::vector<ValueRef>{};
+        }
+        auto cursor = vm::load_cell_slice(result.body);
+        return function->decode_output(cursor);
+    });
+}
+
+auto run_smc_method_if_changed(AccountStateInfo&& account,
+                               td::Ref<Function>&& function,
+                               td::Ref<FunctionCall>&& function_call,
+                               const OutputSnapshot* previous,
+                               ExecutionProfiler* profiler) -> td::Result<OutputSnapshot>
+{
+    return guard_vm_errors([&]() -> td::Result<OutputSnapshot> {
+        TRY_RESULT(result, execute_smc_method(account, *function, std::move(function_call), previous, profiler))
+
+        OutputSnapshot snapshot{};
+        if (!result.executed) {
+            snapshot.body_hash = previous->body_hash;
+            snapshot.changed = false;
+        }
+        else {
+            const auto previous_body = previous != nullptr ? std::optional{previous->body_hash} : std::nullopt;
+            TRY_RESULT_ASSIGN(snapshot, function->decode_output_if_changed(result.body, previous_body))
+        }
+        snapshot.function_id = function->input_id();
+        snapshot.state_hash = result.state_hash;
+        snapshot.balance_hash = result.balance_hash;
+        snapshot.input_hash = result.input_hash;
+        return std::move(snapshot);
+    });
 }
 
 
@@ -8,11 +8,19 @@
 #include <crypto/vm/vm.h>
 #include <tdutils/td/utils/optional.h>
 
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
 #include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
+struct evp_pkey_st;
+
 namespace ftabi
 {
 using BuilderData = td::Ref<vm::DataCell>;
@@ -26,22 +34,187 @@ using ParamRef = td::Ref<Param>;
 struct Value;
 using ValueRef = td::Ref<Value>;
 
+class BitReader;
+
+// VarUInteger 16 holds at most 120 bits. two words keep it native without a compiler specific 128 bit type
+struct GramAmount {
+    static constexpr unsigned MAX_BITS = 120;
+
+    uint64_t hi{};
+    uint64_t lo{};
+
+    auto fits() const -> bool { return (hi >> (MAX_BITS - 64)) == 0; }
+
+    auto operator==(const GramAmount& other) const -> bool { return hi == other.hi && lo == other.lo; }
+    auto operator!=(const GramAmount& other) const -> bool { return !(*this == other); }
+    auto operator<(const GramAmount& other) const -> bool { return hi < other.hi || (hi == other.hi && lo < other.lo); }
+};
+
+class ExecutionProfiler;
+
+// runs tasks of parallel map encoding and decoding, usually on a thread pool owned by the caller.
+// nothing runs in parallel without it
+class Executor {
+public:
+    virtual ~Executor() = default;
+    // number of tasks worth running at once, the calling thread included
+    virtual auto concurrency() const -> size_t = 0;
+    // runs the task on some other thread, it may start after the parallel call is finished
+    virtual auto execute(std::function<void()>&& task) -> void = 0;
+};
+
+static constexpr int ERROR_DECODE_BUDGET_EXCEEDED = 1001;
+
+struct DecodeLimits {
+    size_t max_cells{std::numeric_limits<size_t>::max()};
+    size_t max_depth{std::numeric_limits<size_t>::max()};
+    size_t max_bytes{std::numeric_limits<size_t>::max()};
+    size_t max_map_entries{std::numeric_limits<size_t>::max()};
+
+    // outermost maps with at least this many entries are split by key prefix and decoded on the executor.
+    // 0 disables it, nested maps are always decoded on the thread of the outer one
+    size_t parallel_map_min_entries{0};
+    Executor* executor{};
+};
+
+// resources spent by a single decode. once any limit is exceeded all checks fail
+class DecodeBudget {
+public:
+    // counters of a decode split between threads
+    struct SharedCounters {
+        std::atomic<size_t> cells{};
+        std::atomic<size_t> bytes{};
+        std::atomic<size_t> map_entries{};
+    };
+
+    DecodeBudget() = default;
+    explicit DecodeBudget(const DecodeLimits& limits)
+        : limits_{limits}
+    {
+    }
+
+    auto visit_cell() -> bool { return check(add(cells_, &SharedCounters::cells, 1) <= limits_.max_cells, "cells"); }
+    auto enter() -> bool { return check(++depth_ <= limits_.max_depth, "depth"); }
+    auto leave() -> void { --depth_; }
+    auto consume_bytes(size_t count) -> bool { return check(add(bytes_, &SharedCounters::bytes, count) <= limits_.max_bytes, "bytes"); }
+    auto consume_map_entries(size_t count) -> bool
+    {
+        return check(add(map_entries_, &SharedCounters::map_entries, count) <= limits_.max_map_entries, "map entries");
+    }
+
+    auto enter_map() -> void { ++maps_; }
+    auto leave_map() -> void { --maps_; }
+    // true if no other map is being decoded
+    auto outermost_map() const -> bool { return maps_ == 1; }
+
+    auto limits() const -> const DecodeLimits& { return limits_; }
+
+    // moves counters of this budget into `shared` before forking workers
+    auto share(SharedCounters& shared) const -> void
+    {
+        shared.cells = cells_;
+        shared.bytes = bytes_;
+        shared.map_entries = map_entries_;
+    }
+
+    // budget for a worker thread, all workers spend the same `shared` counters
+    auto fork(SharedCounters& shared) const -> DecodeBudget
+    {
+        DecodeBudget result{limits_};
+        result.shared_ = &shared;
+        result.depth_ = depth_;
+        result.maps_ = maps_;
+        result.exceeded_ = exceeded_;
+        return result;
+    }
+
+    // takes counters back after all workers are finished
+    auto join(const SharedCounters& shared, const DecodeBudget& worker) -> bool
+    {
+        cells_ = shared.cells;
+        bytes_ = shared.bytes;
+        map_entries_ = shared.map_entries;
+        check(worker.exceeded_ == nullptr, worker.exceeded_);
+        return check(cells_ <= limits_.max_cells, "cells") && check(bytes_ <= limits_.max_bytes, "bytes") &&
+               check(map_entries_ <= limits_.max_map_entries, "map entries");
+    }
+
+    auto exceeded() const -> bool { return exceeded_ != nullptr; }
+    auto status() const -> td::Status
+    {
+        return td::Status::Error(ERROR_DECODE_BUDGET_EXCEEDED, PSLICE() << "decode budget exceeded: too many " << exceeded_);
+    }
+
+private:
+    auto add(size_t& local, std::atomic<size_t> SharedCounters::*counter, size_t count) -> size_t
+    {
+        if (shared_ != nullptr) {
+            return (shared_->*counter).fetch_add(count, std::memory_order_relaxed) + count;
+        }
+        return local += count;
+    }
+
+    auto check(bool ok, const char* resource) -> bool
+    {
+        if (!ok && exceeded_ == nullptr) {
+            exceeded_ = resource;
+        }
+        return ok && exceeded_ == nullptr;
+    }
+
+    DecodeLimits limits_{};
+    SharedCounters* shared_{};
+    size_t cells_{};
+    size_t depth_{};
+    size_t bytes_{};
+    size_t map_entries_{};
+    size_t maps_{};
+    const char* exceeded_{};
+};
+
+// moves cursor to the next cell of the chain if the current one doesn't have enough bits
+auto ensure_bits(vm::CellSlice& cursor, unsigned bits, DecodeBudget& budget) -> bool;
+// fetches reference of the cell or bytes value, following the chain if needed
+auto read_cell(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Result<td::Ref<vm::Cell>>;
+
+// interned param name. params with equal names share one string, so thousands of loaded abis
+// keep one copy of each distinct name. the string is released together with its last handle
+class ParamName {
+public:
+    ParamName(const std::string& name);
+    ParamName(const char* name)
+        : ParamName{std::string{name}}
+    {
+    }
+
+    auto str() const -> const std::string& { return *value_; }
+
+    auto operator==(const ParamName& other) const -> bool { return value_ == other.value_; }
+    auto operator!=(const ParamName& other) const -> bool { return value_ != other.value_; }
+
+private:
+    std::shared_ptr<const std::string> value_;
+};
+
 struct Param : public td::CntObject {
-    explicit Param(std::string name, ParamType param_type)
+    explicit Param(ParamName name, ParamType param_type)
         : name_{std::move(name)}
         , param_type_{param_type}
     {
     }
-    auto name() const -> const std::string& { return name_; }
+    auto name() const -> const std::string& { return name_.str(); }
+    auto interned_name() const -> const ParamName& { return name_; }
     auto type() const -> ParamType { return param_type_; }
 
     virtual auto type_signature() const -> std::string = 0;
     virtual auto bit_len() const -> size_t { return 0; }
+    virtual auto max_bit_len() const -> size_t { return bit_len(); }
+    virtual auto max_refs() const -> size_t { return 0; }
     virtual auto default_value() const -> td::Result<ValueRef> { return td::Status::Error("type doesn't have default value and must be explicitly defined"); }
     auto make_copy() const -> Param* override = 0;
 
 protected:
-    std::string name_;
+    ParamName name_;
     ParamType param_type_;
 };
 
@@ -51,11 +224,20 @@ struct Value : public td::CntObject {
     {
     }
     auto param() const -> const ParamRef& { return param_; }
-    auto check_type(const ParamRef& expected) const -> bool { return param_->type_signature() == expected->type_signature(); }
+    auto check_type(const ParamRef& expected) const -> bool
+    {
+        return param_.get() == expected.get() || param_->type_signature() == expected->type_signature();
+    }
 
     virtual auto serialize() const -> td::Result<std::vector<BuilderData>> = 0;
-    virtual auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> = 0;
+    virtual auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status = 0;
+    // decodes without limits. derived values must bring it back into scope with `using Value::decode`
+    auto decode(vm::CellSlice& cursor, bool last) -> td::Status;
+    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData>;
     virtual auto to_string() const -> std::string { return "unknown"; }
+    // default ones compare serialized cells, values override them to skip serialization
+    virtual auto hash() const -> size_t;
+    virtual auto equals(const Value& other) const -> bool;
     auto make_copy() const -> Value* override = 0;
 
 protected:
@@ -65,8 +247,11 @@ protected:
 struct ValueInt : Value {
     explicit ValueInt(ParamRef param, const td::BigInt256& value);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final { return new ValueInt{param_, value}; }
 
     td::BigInt256 value;
@@ -78,8 +263,8 @@ private:
 struct ParamUint : Param {
     using ValueType = ValueInt;
 
-    explicit ParamUint(const std::string& name, size_t size)
-        : Param{name, ParamType::Uint}
+    explicit ParamUint(ParamName name, size_t size)
+        : Param{std::move(name), ParamType::Uint}
         , size{size}
     {
     }
@@ -94,8 +279,8 @@ struct ParamUint : Param {
 struct ParamInt : Param {
     using ValueType = ValueInt;
 
-    explicit ParamInt(const std::string& name, size_t size)
-        : Param{name, ParamType::Int}
+    explicit ParamInt(ParamName name, size_t size)
+        : Param{std::move(name), ParamType::Int}
         , size{size}
     {
     }
@@ -110,8 +295,11 @@ struct ParamInt : Param {
 struct ValueBool : Value {
     explicit ValueBool(ParamRef param, bool value);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
     bool value;
@@ -120,11 +308,12 @@ struct ValueBool : Value {
 struct ParamBool : Param {
     using ValueType = ValueBool;
 
-    explicit ParamBool(const std::string& name)
-        : Param{name, ParamType::Bool}
+    explicit ParamBool(ParamName name)
+        : Param{std::move(name), ParamType::Bool}
     {
     }
     auto type_signature() const -> std::string final { return "bool"; }
+    auto max_bit_len() const -> size_t final { return 1; }
     auto default_value() const -> td::Result<ValueRef> final { return ValueBool{ParamRef{make_copy()}, false}; }
     auto make_copy() const -> Param* final { return new ParamBool{name_}; }
 };
@@ -132,8 +321,11 @@ struct ParamBool : Param {
 struct ValueTuple : Value {
     explicit ValueTuple(ParamRef param, std::vector<ValueRef> values);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
     std::vector<ValueRef> values;
@@ -142,14 +334,14 @@ struct ValueTuple : Value {
 struct ParamTuple : Param {
     using ValueType = ValueTuple;
 
-    explicit ParamTuple(const std::string& name, std::vector<ParamRef> items)
-        : Param{name, ParamType::Tuple}
+    explicit ParamTuple(ParamName name, std::vector<ParamRef> items)
+        : Param{std::move(name), ParamType::Tuple}
         , items{std::move(items)}
     {
     }
     template <typename Arg, typename... Args>
-    explicit ParamTuple(const std::string& name, Arg&& arg, Args&&... args)
-        : Param{name, ParamType::Tuple}
+    explicit ParamTuple(ParamName name, Arg&& arg, Args&&... args)
+        : Param{std::move(name), ParamType::Tuple}
         , items{ParamRef{std::forward(arg)}, ParamRef{std::forward(args)}...}
     {
         static_assert(std::is_base_of_v<Param, Arg> && (std::is_base_of_v<Param, Args> && ...));
@@ -170,6 +362,22 @@ struct ParamTuple : Param {
         }
         return result;
     }
+    auto max_bit_len() const -> size_t final
+    {
+        size_t result = 0;
+        for (const auto& item : items) {
+            result += item->max_bit_len();
+        }
+        return result;
+    }
+    auto max_refs() const -> size_t final
+    {
+        size_t result = 0;
+        for (const auto& item : items) {
+            result += item->max_refs();
+        }
+        return result;
+    }
     auto default_value() const -> td::Result<ValueRef> final
     {
         std::vector<ValueRef> result;
@@ -186,38 +394,42 @@ struct ParamTuple : Param {
 };
 
 struct ParamArray : Param {
-    explicit ParamArray(const std::string& name, ParamRef param)
-        : Param{name, ParamType::Array}
+    explicit ParamArray(ParamName name, ParamRef param)
+        : Param{std::move(name), ParamType::Array}
         , param{std::move(param)}
     {
     }
     template <typename T>
-    explicit ParamArray(const std::string& name, T&& param)
-        : Param{name, ParamType::Array}
+    explicit ParamArray(ParamName name, T&& param)
+        : Param{std::move(name), ParamType::Array}
         , param{std::forward(param)}
     {
     }
     auto type_signature() const -> std::string final { return param->type_signature() + "[]"; }
+    auto max_bit_len() const -> size_t final { return 33; }
+    auto max_refs() const -> size_t final { return 1; }
     auto make_copy() const -> Param* final { return new ParamArray{name_, param}; }
 
     ParamRef param;
 };
 
 struct ParamFixedArray : Param {
-    explicit ParamFixedArray(const std::string& name, ParamRef param, size_t size)
-        : Param{name, ParamType::FixedArray}
+    explicit ParamFixedArray(ParamName name, ParamRef param, size_t size)
+        : Param{std::move(name), ParamType::FixedArray}
         , param{std::move(param)}
         , size{size}
     {
     }
     template <typename T>
-    explicit ParamFixedArray(const std::string& name, T&& param, size_t size)
-        : Param{name, ParamType::FixedArray}
+    explicit ParamFixedArray(ParamName name, T&& param, size_t size)
+        : Param{std::move(name), ParamType::FixedArray}
         , param{std::forward(param)}
         , size{size}
     {
     }
     auto type_signature() const -> std::string final { return param->type_signature() + "[" + std::to_string(size) + "]"; }
+    auto max_bit_len() const -> size_t final { return 1; }
+    auto max_refs() const -> size_t final { return 1; }
     auto make_copy() const -> Param* final { return new ParamFixedArray{name_, param, size}; }
 
     ParamRef param;
@@ -227,8 +439,11 @@ struct ParamFixedArray : Param {
 struct ValueCell : Value {
     explicit ValueCell(ParamRef param, td::Ref<vm::Cell> value);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
     td::Ref<vm::Cell> value;
@@ -237,40 +452,51 @@ struct ValueCell : Value {
 struct ParamCell : Param {
     using ValueType = ValueCell;
 
-    explicit ParamCell(const std::string& name)
-        : Param{name, ParamType::Cell}
+    explicit ParamCell(ParamName name)
+        : Param{std::move(name), ParamType::Cell}
     {
     }
     auto type_signature() const -> std::string final { return "cell"; }
+    auto max_refs() const -> size_t final { return 1; }
     auto default_value() const -> td::Result<ValueRef> final { return ValueCell{ParamRef{make_copy()}, td::Ref<vm::Cell>{}}; }
     auto make_copy() const -> Param* final { return new ParamCell{name_}; }
 };
 
 struct ValueMap : Value {
+    // maps with fewer entries are built on the calling thread even with executor
+    static constexpr size_t PARALLEL_MAP_MIN_ENTRIES = 4096;
+
     explicit ValueMap(ParamRef param, std::vector<std::pair<ValueRef, ValueRef>> values);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    // builds independent subtrees on the executor, result is the same as of `serialize()`. nested maps are built serially
+    auto serialize(Executor& executor) const -> td::Result<std::vector<BuilderData>>;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
     std::vector<std::pair<ValueRef, ValueRef>> values;
 };
 
 struct ParamMap : Param {
-    explicit ParamMap(const std::string& name, ParamRef key, ParamRef value)
-        : Param{name, ParamType::Map}
+    explicit ParamMap(ParamName name, ParamRef key, ParamRef value)
+        : Param{std::move(name), ParamType::Map}
         , key{std::move(key)}
         , value{std::move(value)}
     {
     }
     template <typename K, typename V>
-    explicit ParamMap(const std::string& name, K&& key, V&& value)
-        : Param{name, ParamType::Map}
+    explicit ParamMap(ParamName name, K&& key, V&& value)
+        : Param{std::move(name), ParamType::Map}
         , key{std::forward(key)}
         , value{std::forward(value)}
     {
     }
     auto type_signature() const -> std::string final { return "map(" + key->type_signature() + "," + value->type_signature() + ")"; }
+    auto max_bit_len() const -> size_t final { return 1; }
+    auto max_refs() const -> size_t final { return 1; }
     auto make_copy() const -> Param* final { return new ParamMap{name_, key, value}; }
 
     ParamRef key;
@@ -280,8 +506,11 @@ struct ParamMap : Param {
 struct ValueAddress : Value {
     explicit ValueAddress(ParamRef param, const block::StdAddress& value);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
     block::StdAddress value;
@@ -290,33 +519,92 @@ struct ValueAddress : Value {
 struct ParamAddress : Param {
     using ValueType = ValueAddress;
 
-    explicit ParamAddress(const std::string& name)
-        : Param{name, ParamType::Address}
+    explicit ParamAddress(ParamName name)
+        : Param{std::move(name), ParamType::Address}
     {
     }
     auto type_signature() const -> std::string final { return "address"; }
+    auto max_bit_len() const -> size_t final { return 591; }
     auto default_value() const -> td::Result<ValueRef> final { return ValueAddress{ParamRef{make_copy()}, block::StdAddress{}}; }
     auto make_copy() const -> Param* final { return new ParamAddress{name_}; }
 };
 
+// byte string which keeps short values inline, so fixed bytes don't touch the heap
+class InlineBytes {
+public:
+    static constexpr size_t INLINE_CAPACITY = 32;
+
+    InlineBytes() = default;
+    explicit InlineBytes(size_t size) { resize(size); }
+    InlineBytes(const std::vector<uint8_t>& bytes)
+        : InlineBytes{bytes.data(), bytes.size()}
+    {
+    }
+    InlineBytes(const uint8_t* data, size_t size)
+    {
+        resize(size);
+        std::memcpy(this->data(), data, size);
+    }
+
+    auto data() -> uint8_t* { return size_ <= INLINE_CAPACITY ? inline_.data() : heap_.data(); }
+    auto data() const -> const uint8_t* { return size_ <= INLINE_CAPACITY ? inline_.data() : heap_.data(); }
+    auto size() const -> size_t { return size_; }
+    auto empty() const -> bool { return size_ == 0; }
+    auto is_inline() const -> bool { return size_ <= INLINE_CAPACITY; }
+
+    auto operator[](size_t i) const -> const uint8_t& { return data()[i]; }
+    auto begin() const -> const uint8_t* { return data(); }
+    auto end() const -> const uint8_t* { return data() + size_; }
+
+    auto resize(size_t size) -> void
+    {
+        if (size > INLINE_CAPACITY) {
+            if (is_inline()) {
+                heap_.assign(inline_.begin(), inline_.begin() + size_);
+            }
+            heap_.resize(size);
+        }
+        else if (!is_inline()) {
+            std::memcpy(inline_.data(), heap_.data(), size);
+            heap_.clear();
+        }
+        size_ = size;
+    }
+
+    auto as_slice() const -> td::Slice { return td::Slice{data(), size_}; }
+    auto to_vector() const -> std::vector<uint8_t> { return std::vector<uint8_t>(begin(), end()); }
+
+    auto operator==(const InlineBytes& other) const -> bool { return size_ == other.size_ && std::memcmp(data(), other.data(), size_) == 0; }
+    auto operator!=(const InlineBytes& other) const -> bool { return !(*this == other); }
+
+private:
+    size_t size_{};
+    std::array<uint8_t, INLINE_CAPACITY> inline_{};
+    std::vector<uint8_t> heap_{};
+};
+
 struct ValueBytes : Value {
-    explicit ValueBytes(ParamRef param, std::vector<uint8_t> value);
+    explicit ValueBytes(ParamRef param, InlineBytes value);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
-    std::vector<uint8_t> value;
+    InlineBytes value;
 };
 
 struct ParamBytes : Param {
     using ValueType = ValueBytes;
 
-    explicit ParamBytes(const std::string& name)
-        : Param{name, ParamType::Bytes}
+    explicit ParamBytes(ParamName name)
+        : Param{std::move(name), ParamType::Bytes}
     {
     }
     auto type_signature() const -> std::string final { return "bytes"; }
+    auto max_refs() const -> size_t final { return 1; }
     auto default_value() const -> td::Result<ValueRef> final { return ValueBytes{ParamRef{make_copy()}, {}}; }
     auto make_copy() const -> Param* final { return new ParamBytes{name_}; }
 };
@@ -324,45 +612,62 @@ struct ParamBytes : Param {
 struct ParamFixedBytes : Param {
     using ValueType = ValueBytes;
 
-    explicit ParamFixedBytes(const std::string& name, size_t size)
-        : Param{name, ParamType::FixedBytes}
+    explicit ParamFixedBytes(ParamName name, size_t size)
+        : Param{std::move(name), ParamType::FixedBytes}
         , size{size}
     {
     }
     auto type_signature() const -> std::string final { return "fixedbytes" + std::to_string(size); }
-    auto default_value() const -> td::Result<ValueRef> final { return ValueBytes{ParamRef{make_copy()}, std::vector<uint8_t>(size, 0u)}; }
+    auto max_refs() const -> size_t final { return 1; }
+    auto default_value() const -> td::Result<ValueRef> final { return ValueBytes{ParamRef{make_copy()}, InlineBytes(size)}; }
     auto make_copy() const -> Param* final { return new ParamFixedBytes{name_, size}; }
 
     size_t size;
 };
 
 struct ValueGram : Value {
-    explicit ValueGram(ParamRef param, td::RefInt256 value);
+    // the value must fit into 120 bits, use `create` for unchecked amounts
+    explicit ValueGram(ParamRef param, GramAmount value);
+    static auto create(ParamRef param, GramAmount value) -> td::Result<ValueGram>;
+    static auto create(ParamRef param, const td::RefInt256& value) -> td::Result<ValueGram>;
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
-    td::RefInt256 value;
+    auto amount() const -> GramAmount { return value; }
+    auto to_int() const -> td::RefInt256;
+
+    GramAmount value;
 };
 
+auto store_grams(vm::CellBuilder& cb, GramAmount value) -> bool;
+auto fetch_grams(vm::CellSlice& cs, GramAmount& value) -> bool;
+
 struct ParamGram : Param {
     using ValueType = ValueGram;
 
-    explicit ParamGram(const std::string& name)
-        : Param{name, ParamType::Gram}
+    explicit ParamGram(ParamName name)
+        : Param{std::move(name), ParamType::Gram}
     {
     }
     auto type_signature() const -> std::string final { return "gram"; }
-    auto default_value() const -> td::Result<ValueRef> final { return ValueGram{ParamRef{make_copy()}, td::make_refint(0)}; }
+    auto max_bit_len() const -> size_t final { return 4 + 15 * 8; }
+    auto default_value() const -> td::Result<ValueRef> final { return ValueGram{ParamRef{make_copy()}, GramAmount{}}; }
     auto make_copy() const -> Param* final { return new ParamGram{name_}; }
 };
 
 struct ValueTime : Value {
     explicit ValueTime(ParamRef param, td::uint64 value);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
     td::uint64 value;
@@ -371,11 +676,12 @@ struct ValueTime : Value {
 struct ParamTime : Param {
     using ValueType = ValueTime;
 
-    explicit ParamTime(const std::string& name)
-        : Param{name, ParamType::Time}
+    explicit ParamTime(ParamName name)
+        : Param{std::move(name), ParamType::Time}
     {
     }
     auto type_signature() const -> std::string final { return "time"; }
+    auto max_bit_len() const -> size_t final { return 64; }
     auto default_value() const -> td::Result<ValueRef> final
     {
         const auto duration = std::chrono::system_clock::now().time_since_epoch();
@@ -388,8 +694,11 @@ struct ParamTime : Param {
 struct ValueExpire : Value {
     explicit ValueExpire(ParamRef param, uint32_t value);
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
     uint32_t value;
@@ -398,40 +707,106 @@ struct ValueExpire : Value {
 struct ParamExpire : Param {
     using ValueType = ValueExpire;
 
-    explicit ParamExpire(const std::string& name)
-        : Param{name, ParamType::Expire}
+    explicit ParamExpire(ParamName name)
+        : Param{std::move(name), ParamType::Expire}
     {
     }
     auto type_signature() const -> std::string final { return "expire"; }
+    auto max_bit_len() const -> size_t final { return 32; }
     auto default_value() const -> td::Result<ValueRef> final { return ValueExpire{ParamRef{make_copy()}, std::numeric_limits<uint32_t>::max()}; }
     auto make_copy() const -> Param* final { return new ParamExpire{name_}; }
 };
 
 struct ValuePublicKey : Value {
-    explicit ValuePublicKey(ParamRef param, std::optional<td::SecureString> value);
+    explicit ValuePublicKey(ParamRef param, std::optional<td::Bits256> value);
+    // keys of the old representation, which must be exactly 32 bytes long
+    static auto create(ParamRef param, const td::SecureString& value) -> td::Result<ValuePublicKey>;
+    static auto create(ParamRef param, const std::optional<td::SecureString>& value) -> td::Result<ValuePublicKey>;
     auto serialize() const -> td::Result<std::vector<BuilderData>> final;
-    auto deserialize(SliceData&& cursor, bool last) -> td::Result<SliceData> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
     auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
     auto make_copy() const -> Value* final;
 
-    std::optional<td::SecureString> value;
+    std::optional<td::Bits256> value;
 };
 
 struct ParamPublicKey : Param {
     using ValueType = ValuePublicKey;
 
-    explicit ParamPublicKey(const std::string& name)
-        : Param{name, ParamType::PublicKey}
+    explicit ParamPublicKey(ParamName name)
+        : Param{std::move(name), ParamType::PublicKey}
     {
     }
     auto type_signature() const -> std::string final { return "pubkey"; }
+    auto max_bit_len() const -> size_t final { return 1 + 256; }
     auto default_value() const -> td::Result<ValueRef> final { return ValuePublicKey{ParamRef{make_copy()}, decltype(std::declval<ValuePublicKey>().value){}}; }
     auto make_copy() const -> Param* final { return new ParamPublicKey{name_}; }
 };
 
+// value which was serialized once and is spliced into the message as is
+struct EncodedValue : Value {
+    explicit EncodedValue(ValueRef value, std::vector<BuilderData> cells);
+    auto serialize() const -> td::Result<std::vector<BuilderData>> final;
+    using Value::decode;
+    auto decode(vm::CellSlice& cursor, bool last, DecodeBudget& budget) -> td::Status final;
+    auto to_string() const -> std::string final;
+    auto hash() const -> size_t final;
+    auto equals(const Value& other) const -> bool final;
+    auto make_copy() const -> Value* final;
+
+    const ValueRef value;
+    const std::vector<BuilderData> cells;
+};
+
+auto make_encoded(const ValueRef& value) -> td::Result<ValueRef>;
+
+// moves the cursor past the value without materializing it, following the same cell chain rules as decoding
+auto skip_value(vm::CellSlice& cursor, const Param& param, bool last, DecodeBudget& budget) -> td::Status;
+
+// calls `f` for each entry of the map value in key order. `key` holds exactly the key bits,
+// `value` is the leaf or the referenced cell when values don't fit into leaves
+using MapEntryCallback = std::function<td::Status(BitReader& key, vm::CellSlice& value)>;
+auto read_map(vm::CellSlice& cursor, const ParamMap& param, bool last, DecodeBudget& budget, const MapEntryCallback& f) -> td::Status;
+
+struct ValueHash {
+    auto operator()(const ValueRef& value) const -> size_t { return value.is_null() ? 0 : value->hash(); }
+};
+
+struct ValueEqual {
+    auto operator()(const ValueRef& left, const ValueRef& right) const -> bool
+    {
+        return left.get() == right.get() || (left.not_null() && right.not_null() && left->equals(*right));
+    }
+};
+
 auto fill_signature(const std::optional<td::SecureString>& signature, BuilderData&& cell) -> td::Result<BuilderData>;
+
+// external call body starts with the signature flag, set if zeroed placeholder for signature follows.
+// `hash` is the hash of the root cell without them. internal call bodies are complete
+struct UnsignedCall {
+    BuilderData body{};
+    vm::CellHash hash{};
+};
+
+// replaces the placeholder of an external call body
+auto fill_signature(const std::optional<td::SecureString>& signature, const UnsignedCall& call) -> td::Result<BuilderData>;
 auto pack_cells_into_chain(std::vector<BuilderData>&& cells) -> td::Result<BuilderData>;
 
+// index of the cell in chain for each serialized leaf value
+using CellLayout = std::vector<uint16_t>;
+// cells of the first and the last leaf of each encoded param
+using ParamCells = std::vector<std::pair<uint16_t, uint16_t>>;
+
+// max bits and refs of each leaf in serialization order
+using LeafSizes = std::vector<std::pair<size_t, size_t>>;
+
+auto append_leaf_sizes(const ParamRef& param, LeafSizes& sizes) -> void;
+auto compute_fixed_layout(const LeafSizes& sizes) -> td::Result<CellLayout>;
+auto pack_cells_by_layout(std::vector<BuilderData>&& cells, const CellLayout& layout) -> td::Result<BuilderData>;
+
 using HeaderParams = std::vector<ParamRef>;
 using InputParams = std::vector<ParamRef>;
 using OutputParams = std::vector<ParamRef>;
@@ -439,6 +814,23 @@ using OutputParams = std::vector<ParamRef>;
 using HeaderValues = std::unordered_map<std::string, ValueRef>;
 using InputValues = std::vector<ValueRef>;
 
+static constexpr size_t MAX_HEADER_SLOTS = 8;
+
+// header values indexed by the position of the param in function header.
+// params after the first `MAX_HEADER_SLOTS` ones are looked up by name in `overflow`
+struct HeaderSlots {
+    auto set_time(td::uint64 value) -> HeaderSlots&;
+    auto set_expire(uint32_t value) -> HeaderSlots&;
+    auto set_pubkey(const td::Bits256& value) -> HeaderSlots&;
+    auto set(size_t slot, ValueRef value) -> td::Status;
+
+    std::optional<td::uint64> time{};
+    std::optional<uint32_t> expire{};
+    std::optional<td::Bits256> pubkey{};
+    std::array<ValueRef, MAX_HEADER_SLOTS> values{};
+    HeaderValues overflow{};
+};
+
 template <typename P, typename... Args>
 static auto make_value(P&& param, Args&&... args) -> ValueRef
 {
@@ -471,17 +863,68 @@ static constexpr uint8_t ABI_VERSION = 2;
 auto compute_function_id(const std::string& signature) -> uint32_t;
 auto compute_function_signature(const std::string& name, const InputParams& inputs, const OutputParams& outputs) -> std::string;
 
+// decoded output together with the hashes it was produced from.
+// `changed` is false when the hashes matched the previous ones and execution or decoding was skipped
+struct OutputSnapshot {
+    // what the getter read, set by `run_smc_method_if_changed`: called function, account code and data,
+    // balance and the external message with encoded inputs
+    uint32_t function_id{};
+    vm::CellHash state_hash{};
+    vm::CellHash balance_hash{};
+    vm::CellHash input_hash{};
+    // zero if there was no output message
+    vm::CellHash body_hash{};
+    bool changed{true};
+    std::vector<ValueRef> values{};
+};
+
+// inbound call body parsed back into values.
+// `unsigned_hash` is the hash signed by the sender, so it can be checked against `signature` directly
+struct DecodedInput {
+    std::optional<td::SecureString> signature{};
+    vm::CellHash unsigned_hash{};
+    HeaderValues header{};
+    uint32_t function_id{};
+    std::vector<ValueRef> inputs{};
+};
+
+// ed25519 key expanded once and shared between calls and threads.
+// key material is wiped by openssl when the last reference is dropped
+class SigningKey : public td::CntObject {
+public:
+    static auto create(const td::Ed25519::PrivateKey& private_key) -> td::Result<td::Ref<SigningKey>>;
+    SigningKey(SigningKey&& other) noexcept;
+    SigningKey(const SigningKey&) = delete;
+    ~SigningKey() override;
+
+    auto sign(td::Slice data) const -> td::Result<td::SecureString>;
+    auto public_key() const -> const td::Bits256& { return public_key_; }
+
+    auto make_copy() const -> SigningKey* final;
+
+private:
+    SigningKey(::evp_pkey_st* pkey, const td::Bits256& public_key);
+
+    ::evp_pkey_st* pkey_;
+    td::Bits256 public_key_;
+};
+
 struct FunctionCall : public td::CntObject {
     explicit FunctionCall(InputValues&& inputs);
     explicit FunctionCall(HeaderValues&& header, InputValues&& inputs);
     explicit FunctionCall(HeaderValues&& header, InputValues&& inputs, bool internal, std::optional<td::Ed25519::PrivateKey>&& private_key);
+    explicit FunctionCall(HeaderSlots&& header, InputValues&& inputs, bool internal, std::optional<td::Ed25519::PrivateKey>&& private_key);
+    explicit FunctionCall(HeaderSlots&& header, InputValues&& inputs, td::Ref<SigningKey> signing_key);
 
     auto make_copy() const -> FunctionCall* final;
 
     HeaderValues header{};
+    std::optional<HeaderSlots> header_slots{};
     InputValues inputs{};
     bool internal{};
     std::optional<td::Ed25519::PrivateKey> private_key{};
+    // takes precedence over `private_key`
+    td::Ref<SigningKey> signing_key{};
     bool body_as_ref{};
 };
 
@@ -490,22 +933,66 @@ public:
     explicit Function(std::string&& name, HeaderParams&& header, InputParams&& inputs, OutputParams&& outputs, uint32_t input_id, uint32_t output_id);
     explicit Function(std::string&& name, HeaderParams&& header, InputParams&& inputs, OutputParams&& outputs);
     explicit Function(std::string&& name, HeaderParams&& header, InputParams&& inputs, OutputParams&& outputs, uint32_t id);
+    // function which encodes and decodes calls with the fixed layout, where cell boundaries depend only on
+    // max sizes of params. fails if some param doesn't fit into one cell
+    static auto with_fixed_layout(std::string&& name, HeaderParams&& header, InputParams&& inputs, OutputParams&& outputs, uint32_t input_id,
+                                  uint32_t output_id) -> td::Result<td::Ref<Function>>;
 
-    auto encode_input(FunctionCall& call) const -> td::Result<BuilderData>;
+    auto encode_input(const FunctionCall& call) const -> td::Result<BuilderData>;
     auto encode_input(const td::Ref<FunctionCall>& call) const -> td::Result<BuilderData>;
     auto encode_input(const HeaderValues& header, const InputValues& inputs, bool internal, const std::optional<td::Ed25519::PrivateKey>& private_key) const
     -> td::Result<BuilderData>;
+    auto encode_input(const HeaderSlots& header, const InputValues& inputs, bool internal, const std::optional<td::Ed25519::PrivateKey>& private_key) const
+    -> td::Result<BuilderData>;
+    auto encode_input(const HeaderSlots& header, const InputValues& inputs, bool internal, const td::Ref<SigningKey>& signing_key) const
+    -> td::Result<BuilderData>;
+    // packs all calls first and then hashes their unsigned roots in one multi-buffer pass
+    auto encode_inputs(const std::vector<td::Ref<FunctionCall>>& calls) const -> std::vector<td::Result<BuilderData>>;
+
+    auto decode_input(vm::CellSlice& cursor, bool internal) const -> td::Result<DecodedInput>;
+    auto decode_input(vm::CellSlice& cursor, bool internal, const DecodeLimits& limits) const -> td::Result<DecodedInput>;
+    // signature, header values and function id, leaving cursor at the first input
+    auto decode_input_header(vm::CellSlice& cursor, bool internal, DecodeBudget& budget) const -> td::Result<DecodedInput>;
+    auto decode_input_params(vm::CellSlice& cursor, bool internal, DecodeBudget& budget) const -> td::Result<std::vector<ValueRef>>;
 
+    // checks output id, leaving cursor at the first output
+    auto decode_output_id(vm::CellSlice& cursor) const -> td::Status;
     auto decode_output(SliceData&& data) const -> td::Result<std::vector<ValueRef>>;
-    auto decode_params(SliceData&& cursor) const -> td::Result<std::vector<ValueRef>>;
+    auto decode_output(vm::CellSlice& cursor) const -> td::Result<std::vector<ValueRef>>;
+    auto decode_output(vm::CellSlice& cursor, const DecodeLimits& limits) const -> td::Result<std::vector<ValueRef>>;
+    // null body means no output message, it fails for functions with outputs
+    auto decode_output_if_changed(const td::Ref<vm::Cell>& body, const std::optional<vm::CellHash>& previous) const -> td::Result<OutputSnapshot>;
+    auto decode_params(SliceData&& data) const -> td::Result<std::vector<ValueRef>>;
+    auto decode_params(vm::CellSlice& cursor) const -> td::Result<std::vector<ValueRef>>;
+    auto decode_params(vm::CellSlice& cursor, DecodeBudget& budget) const -> td::Result<std::vector<ValueRef>>;
 
     auto encode_header(const HeaderValues& header, bool internal) const -> td::Result<std::vector<BuilderData>>;
+    auto encode_header(const HeaderSlots& header, bool internal) const -> td::Result<std::vector<BuilderData>>;
 
     auto create_unsigned_call(const HeaderValues& header, const InputValues& inputs, bool internal, bool reserve_sign) const
     -> td::Result<std::pair<BuilderData, vm::CellHash>>;
+    auto create_unsigned_call(const HeaderSlots& header, const InputValues& inputs, bool internal, bool reserve_sign) const
+    -> td::Result<std::pair<BuilderData, vm::CellHash>>;
+    // placeholder is reserved for external calls with a key, or for all of them with `reserve_sign`.
+    // bodies have the same layout as `encode_input` produces. only unsigned roots of external calls are
+    // hashed in a batch, all other cells are hashed by the vm when they are finalized
+    auto create_unsigned_calls(const std::vector<td::Ref<FunctionCall>>& calls, bool reserve_sign = false) const
+        -> std::vector<td::Result<UnsignedCall>>;
+
+    // fails for params without a slot, their values are set by name in `HeaderSlots::overflow`
+    auto header_slot(const std::string& name) const -> td::Result<size_t>;
+    auto make_header_slots(const HeaderValues& header) const -> td::Result<HeaderSlots>;
 
     auto make_copy() const -> Function* final;
 
+    auto name() const -> const std::string& { return name_; }
+
+    auto has_fixed_layout() const -> bool { return fixed_layout_; }
+
+    auto header() const -> const HeaderParams& { return header_; }
+    auto inputs() const -> const InputParams& { return inputs_; }
+    auto outputs() const -> const OutputParams& { return outputs_; }
+
     auto has_input() const -> bool { return !inputs_.empty(); }
     auto has_output() const -> bool { return !outputs_.empty(); }
 
@@ -513,12 +1000,52 @@ public:
     auto output_id() const -> uint32_t { return output_id_; }
 
 private:
+    auto prepare_decoder() -> void;
+    auto init_fixed_layout() -> td::Status;
+    // root cell and number of bits before the header, which are not signed
+    auto pack_call(const HeaderSlots& header, const InputValues& inputs, bool internal, bool reserve_sign) const
+        -> td::Result<std::pair<BuilderData, size_t>>;
+
     std::string name_{};
     HeaderParams header_{};
     InputParams inputs_{};
     OutputParams outputs_{};
     uint32_t input_id_ = 0;
     uint32_t output_id_ = 0;
+
+    // max bit length of the run of static-width params starting at each index (0 for dynamic params)
+    std::vector<uint32_t> input_run_bits_{};
+    std::vector<uint32_t> output_run_bits_{};
+
+    bool fixed_layout_{};
+    CellLayout external_layout_{};
+    CellLayout internal_layout_{};
+    // header params, function id and inputs, in this order. the signature is always in the first cell
+    ParamCells external_cells_{};
+    // function id and inputs
+    ParamCells internal_cells_{};
+};
+
+class Contract : public td::CntObject {
+public:
+    explicit Contract(std::string&& name, std::vector<td::Ref<Function>>&& functions);
+
+    auto find_function(const std::string& name) const -> td::Result<td::Ref<Function>>;
+    auto find_function_by_input_id(uint32_t input_id) const -> td::Result<td::Ref<Function>>;
+
+    // decodes inbound call of any function of the contract. all functions share the same header
+    auto decode_input(vm::CellSlice& cursor, bool internal) const -> td::Result<std::pair<td::Ref<Function>, DecodedInput>>;
+    auto decode_input(vm::CellSlice& cursor, bool internal, const DecodeLimits& limits) const
+        -> td::Result<std::pair<td::Ref<Function>, DecodedInput>>;
+
+    auto make_copy() const -> Contract* final;
+
+    auto name() const -> const std::string& { return name_; }
+    auto functions() const -> const std::vector<td::Ref<Function>>& { return functions_; }
+
+private:
+    std::string name_{};
+    std::vector<td::Ref<Function>> functions_{};
 };
 
 enum class AccountState {
@@ -558,6 +1085,21 @@ struct AccountStateInfo {
     block::AccountState::Info state_details_info;
 };
 
-auto run_smc_method(AccountStateInfo&& account, td::Ref<Function>&& function, td::Ref<FunctionCall>&& function_call) -> td::Result<std::vector<ValueRef>>;
+// extracts body of the external outbound message
+auto unpack_message(td::Ref<vm::Cell>& msg) -> td::Result<td::Ref<vm::Cell>>;
+
+auto run_smc_method(AccountStateInfo&& account,
+                    td::Ref<Function>&& function,
+                    td::Ref<FunctionCall>&& function_call,
+                    ExecutionProfiler* profiler = nullptr) -> td::Result<std::vector<ValueRef>>;
+
+// same as run_smc_method, but skips execution when the function, encoded call, account code, data and balance
+// are the same as for `previous`, and decoding when the output body is the same. outputs which depend only on
+// time are not refreshed until something else changes. a function with outputs fails if no output message was sent
+auto run_smc_method_if_changed(AccountStateInfo&& account,
+                               td::Ref<Function>&& function,
+                               td::Ref<FunctionCall>&& function_call,
+                               const OutputSnapshot* previous,
+                               ExecutionProfiler* profiler = nullptr) -> td::Result<OutputSnapshot>;
 
 }  // namespace ftabi
@@ -0,0 +1,371 @@
+#include "BatchHash.hpp"
+
+#include <td/utils/crypto.h>
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FTABI_SHA256_LANES 1
+#include <immintrin.h>
+#endif
+
+namespace ftabi
+{
+namespace
+{
+constexpr uint32_t SHA256_IV[8] = {0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u};
+
+auto sha256_scalar(td::Span<td::Slice> messages, unsigned char* digests) -> void
+{
+    for (size_t i = 0; i < messages.size(); ++i) {
+        td::sha256(messages[i], td::MutableSlice{digests + i * 32, 32});
+    }
+}
+
+#if FTABI_SHA256_LANES
+constexpr uint32_t SHA256_K[64] = {
+    0x428a2f98u, 0x71374491u, 0xb5c0fbcfu, 0xe9b5dba5u, 0x3956c25bu, 0x59f111f1u, 0x923f82a4u, 0xab1c5ed5u, 0xd807aa98u, 0x12835b01u, 0x243185beu,
+    0x550c7dc3u, 0x72be5d74u, 0x80deb1feu, 0x9bdc06a7u, 0xc19bf174u, 0xe49b69c1u, 0xefbe4786u, 0x0fc19dc6u, 0x240ca1ccu, 0x2de92c6fu, 0x4a7484aau,
+    0x5cb0a9dcu, 0x76f988dau, 0x983e5152u, 0xa831c66du, 0xb00327c8u, 0xbf597fc7u, 0xc6e00bf3u, 0xd5a79147u, 0x06ca6351u, 0x14292967u, 0x27b70a85u,
+    0x2e1b2138u, 0x4d2c6dfcu, 0x53380d13u, 0x650a7354u, 0x766a0abbu, 0x81c2c92eu, 0x92722c85u, 0xa2bfe8a1u, 0xa81a664bu, 0xc24b8b70u, 0xc76c51a3u,
+    0xd192e819u, 0xd6990624u, 0xf40e3585u, 0x106aa070u, 0x19a4c116u, 0x1e376c08u, 0x2748774cu, 0x34b0bcb5u, 0x391c0cb3u, 0x4ed8aa4au, 0x5b9cca4fu,
+    0x682e6ff3u, 0x748f82eeu, 0x78a5636fu, 0x84c87814u, 0x8cc70208u, 0x90befffau, 0xa4506cebu, 0xbef9a3f7u, 0xc67178f2u};
+
+// compresses one block per lane. `state` and `words` are transposed: word `i` of all lanes is stored contiguously
+using CompressLanes = void (*)(uint32_t* state, const uint32_t* words);
+
+// avx2, 8 lanes
+
+#define FTABI_AVX2 __attribute__((target("avx2"), always_inline)) inline
+
+FTABI_AVX2 auto rotr_avx2(__m256i x, int n) -> __m256i
+{
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+FTABI_AVX2 auto add_avx2(__m256i a, __m256i b, __m256i c, __m256i d) -> __m256i
+{
+    return _mm256_add_epi32(_mm256_add_epi32(a, b), _mm256_add_epi32(c, d));
+}
+
+__attribute__((target("avx2"))) auto compress_avx2(uint32_t* state, const uint32_t* words) -> void
+{
+    __m256i w[16];
+    __m256i s[8];
+    for (int i = 0; i < 8; ++i) {
+        s[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(state + i * 8));
+    }
+    for (int i = 0; i < 16; ++i) {
+        w[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(words + i * 8));
+    }
+
+    auto a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; ++i) {
+        if (i >= 16) {
+            const auto w15 = w[(i - 15) & 15];
+            const auto w2 = w[(i - 2) & 15];
+            const auto s0 = _mm256_xor_si256(_mm256_xor_si256(rotr_avx2(w15, 7), rotr_avx2(w15, 18)), _mm256_srli_epi32(w15, 3));
+            const auto s1 = _mm256_xor_si256(_mm256_xor_si256(rotr_avx2(w2, 17), rotr_avx2(w2, 19)), _mm256_srli_epi32(w2, 10));
+            w[i & 15] = add_avx2(w[i & 15], s0, w[(i - 7) & 15], s1);
+        }
+
+        const auto sum1 = _mm256_xor_si256(_mm256_xor_si256(rotr_avx2(e, 6), rotr_avx2(e, 11)), rotr_avx2(e, 25));
+        const auto ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+        const auto t1 = add_avx2(h, sum1, ch, _mm256_add_epi32(w[i & 15], _mm256_set1_epi32(static_cast<int>(SHA256_K[i]))));
+        const auto sum0 = _mm256_xor_si256(_mm256_xor_si256(rotr_avx2(a, 2), rotr_avx2(a, 13)), rotr_avx2(a, 22));
+        const auto maj = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm256_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm256_add_epi32(t1, _mm256_add_epi32(sum0, maj));
+    }
+
+    const __m256i result[8] = {a, b, c, d, e, f, g, h};
+    for (int i = 0; i < 8; ++i) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(state + i * 8), _mm256_add_epi32(s[i], result[i]));
+    }
+}
+
+#undef FTABI_AVX2
+
+// avx-512, 16 lanes
+
+__attribute__((target("avx512f"))) auto compress_avx512(uint32_t* state, const uint32_t* words) -> void
+{
+    __m512i w[16];
+    __m512i s[8];
+    for (int i = 0; i < 8; ++i) {
+        s[i] = _mm512_load_si512(state + i * 16);
+    }
+    for (int i = 0; i < 16; ++i) {
+        w[i] = _mm512_load_si512(words + i * 16);
+    }
+
+    auto a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+    for (int i = 0; i < 64; ++i) {
+        if (i >= 16) {
+            const auto w15 = w[(i - 15) & 15];
+            const auto w2 = w[(i - 2) & 15];
+            // 0x96 is three way xor
+            const auto s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w15, 7), _mm512_ror_epi32(w15, 18), _mm512_srli_epi32(w15, 3), 0x96);
+            const auto s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w2, 17), _mm512_ror_epi32(w2, 19), _mm512_srli_epi32(w2, 10), 0x96);
+            w[i & 15] = _mm512_add_epi32(_mm512_add_epi32(w[i & 15], s0), _mm512_add_epi32(w[(i - 7) & 15], s1));
+        }
+
+        const auto sum1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6), _mm512_ror_epi32(e, 11), _mm512_ror_epi32(e, 25), 0x96);
+        // 0xca is `e ? f : g`, 0xe8 is majority
+        const auto ch = _mm512_ternarylogic_epi32(e, f, g, 0xca);
+        const auto t1 = _mm512_add_epi32(_mm512_add_epi32(h, sum1), _mm512_add_epi32(ch, _mm512_add_epi32(w[i & 15], _mm512_set1_epi32(static_cast<int>(SHA256_K[i])))));
+        const auto sum0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2), _mm512_ror_epi32(a, 13), _mm512_ror_epi32(a, 22), 0x96);
+        const auto maj = _mm512_ternarylogic_epi32(a, b, c, 0xe8);
+
+        h = g;
+        g = f;
+        f = e;
+        e = _mm512_add_epi32(d, t1);
+        d = c;
+        c = b;
+        b = a;
+        a = _mm512_add_epi32(t1, _mm512_add_epi32(sum0, maj));
+    }
+
+    const __m512i result[8] = {a, b, c, d, e, f, g, h};
+    for (int i = 0; i < 8; ++i) {
+        _mm512_store_si512(state + i * 16, _mm512_add_epi32(s[i], result[i]));
+    }
+}
+
+// keeps every lane busy: when a message is finished, the next one takes its lane
+template <size_t Lanes, CompressLanes Compress>
+auto sha256_lanes(td::Span<td::Slice> messages, unsigned char* digests) -> void
+{
+    struct Lane {
+        size_t message;
+        const unsigned char* data;
+        size_t blocks;
+        size_t tail_blocks;
+        unsigned char tail[128];
+    };
+
+    alignas(64) uint32_t state[8 * Lanes];
+    alignas(64) uint32_t words[16 * Lanes];
+    static constexpr unsigned char idle_block[64] = {};
+
+    Lane lanes[Lanes];
+    size_t next = 0;
+    size_t active = 0;
+
+    const auto start = [&](size_t lane) {
+        auto& item = lanes[lane];
+        if (next == messages.size()) {
+            item.message = messages.size();
+            return;
+        }
+
+        const auto& message = messages[next];
+        const auto rest = message.size() % 64;
+        item.message = next++;
+        item.data = message.ubegin();
+        item.blocks = message.size() / 64;
+        item.tail_blocks = rest + 9 <= 64 ? 1 : 2;
+
+        // final blocks: rest of the message, 0x80, zeros and message length in bits
+        std::memcpy(item.tail, item.data + item.blocks * 64, rest);
+        std::memset(item.tail + rest, 0, sizeof(item.tail) - rest);
+        item.tail[rest] = 0x80u;
+        auto bit_len = static_cast<uint64_t>(message.size()) * 8;
+        for (size_t i = item.tail_blocks * 64; i > item.tail_blocks * 64 - 8; --i, bit_len >>= 8u) {
+            item.tail[i - 1] = static_cast<unsigned char>(bit_len & 0xffu);
+        }
+
+        for (size_t i = 0; i < 8; ++i) {
+            state[i * Lanes + lane] = SHA256_IV[i];
+        }
+        ++active;
+    };
+
+    for (size_t lane = 0; lane < Lanes; ++lane) {
+        start(lane);
+    }
+
+    while (active > 0) {
+        for (size_t lane = 0; lane < Lanes; ++lane) {
+            const auto& item = lanes[lane];
+            const unsigned char* block = idle_block;
+            if (item.message < messages.size()) {
+                block = item.blocks > 0 ? item.data : item.tail;
+            }
+            for (size_t i = 0; i < 16; ++i) {
+                uint32_t word;
+                std::memcpy(&word, block + i * 4, 4);
+                words[i * Lanes + lane] = __builtin_bswap32(word);
+            }
+        }
+
+        Compress(state, words);
+
+        for (size_t lane = 0; lane < Lanes; ++lane) {
+            auto& item = lanes[lane];
+            if (item.message == messages.size()) {
+                continue;
+            }
+
+            if (item.blocks > 0) {
+                item.data += 64;
+                --item.blocks;
+                continue;
+            }
+            if (--item.tail_blocks > 0) {
+                // second tail block is processed from the start of the buffer
+                std::memmove(item.tail, item.tail + 64, 64);
+                continue;
+            }
+
+            auto* digest = digests + item.message * 32;
+            for (size_t i = 0; i < 8; ++i) {
+                const auto word = __builtin_bswap32(state[i * Lanes + lane]);
+                std::memcpy(digest + i * 4, &word, 4);
+            }
+            --active;
+            start(lane);
+        }
+    }
+}
+#endif
+
+auto available_kernels() -> std::vector<std::pair<const char*, Sha256BatchKernel>>
+{
+    std::vector<std::pair<const char*, Sha256BatchKernel>> result{};
+#if FTABI_SHA256_LANES
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        result.emplace_back("avx512", &sha256_lanes<16, &compress_avx512>);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        result.emplace_back("avx2", &sha256_lanes<8, &compress_avx2>);
+    }
+#endif
+    result.emplace_back("scalar", &sha256_scalar);
+    return result;
+}
+
+auto kernel() -> const std::pair<const char*, Sha256BatchKernel>&
+{
+    static const auto selected = available_kernels().front();
+    return selected;
+}
+
+}  // namespace
+
+auto sha256_batch(td::Span<td::Slice> messages, unsigned char* digests) -> void
+{
+    // lanes don't pay off for a couple of messages
+    if (messages.size() < 4) {
+        sha256_scalar(messages, digests);
+        return;
+    }
+    kernel().second(messages, digests);
+}
+
+auto sha256_batch_kernel() -> const char*
+{
+    return kernel().first;
+}
+
+auto sha256_batch_kernels() -> std::vector<std::pair<const char*, Sha256BatchKernel>>
+{
+    return available_kernels();
+}
+
+auto store_cell_repr(const vm::CellSlice& cs, unsigned char* repr) -> size_t
+{
+    const auto bits = cs.size();
+    const auto refs = cs.size_refs();
+    for (unsigned i = 0; i < refs; ++i) {
+        if (cs.prefetch_ref(i)->get_level() != 0) {
+            return 0;
+        }
+    }
+
+    const auto data_bytes = (bits + 7u) >> 3u;
+    repr[0] = static_cast<unsigned char>(refs);
+    repr[1] = static_cast<unsigned char>((bits >> 3u) + data_bytes);
+
+    std::memset(repr + 2, 0, data_bytes);
+    const auto data_bits = cs.data_bits();
+    td::bitstring::bits_memcpy(repr + 2, 0, data_bits.ptr, data_bits.offs, bits);
+    if (bits & 7u) {
+        repr[2 + (bits >> 3u)] |= static_cast<unsigned char>(0x80u >> (bits & 7u));
+    }
+
+    auto* ptr = repr + 2 + data_bytes;
+    for (unsigned i = 0; i < refs; ++i) {
+        const auto depth = cs.prefetch_ref(i)->get_depth();
+        *ptr++ = static_cast<unsigned char>(depth >> 8u);
+        *ptr++ = static_cast<unsigned char>(depth & 0xffu);
+    }
+    for (unsigned i = 0; i < refs; ++i) {
+        const auto hash = cs.prefetch_ref(i)->get_hash();
+        std::memcpy(ptr, hash.as_slice().data(), 32);
+        ptr += 32;
+    }
+    return static_cast<size_t>(ptr - repr);
+}
+
+// cell hash batch
+
+auto CellHashBatch::reserve(size_t count) -> void
+{
+    reprs_.reserve(count * MAX_CELL_REPR_SIZE);
+    pending_.reserve(count);
+    hashes_.reserve(count);
+}
+
+auto CellHashBatch::add(const vm::CellSlice& cs) -> size_t
+{
+    const auto index = hashes_.size();
+    const auto offset = reprs_.size();
+    reprs_.resize(offset + MAX_CELL_REPR_SIZE);
+
+    const auto size = store_cell_repr(cs, reprs_.data() + offset);
+    reprs_.resize(offset + size);
+    if (size == 0) {
+        vm::CellBuilder cb{};
+        CHECK(cb.append_cellslice_bool(cs))
+        hashes_.emplace_back(cb.finalize()->get_hash());
+    }
+    else {
+        pending_.emplace_back(Pending{index, offset, size});
+        hashes_.emplace_back();
+    }
+    return index;
+}
+
+auto CellHashBatch::compute() -> std::vector<vm::CellHash>
+{
+    // slices are made only now, representations buffer could be reallocated while adding
+    std::vector<td::Slice> messages{};
+    messages.reserve(pending_.size());
+    for (const auto& item : pending_) {
+        messages.emplace_back(td::Slice{reprs_.data() + item.offset, item.size});
+    }
+
+    std::vector<unsigned char> digests(pending_.size() * 32);
+    sha256_batch(td::Span<td::Slice>{messages}, digests.data());
+    for (size_t i = 0; i < pending_.size(); ++i) {
+        hashes_[pending_[i].index] = vm::CellHash::from_slice(td::Slice{digests.data() + i * 32, 32});
+    }
+
+    reprs_.clear();
+    pending_.clear();
+    return std::exchange(hashes_, {});
+}
+
+}  // namespace ftabi
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <crypto/vm/cells.h>
+#include <crypto/vm/cellslice.h>
+
+#include <td/utils/Span.h>
+
+#include <utility>
+#include <vector>
+
+namespace ftabi
+{
+// d1, d2, data padded to bytes, ref depths and ref hashes of an ordinary cell
+constexpr size_t MAX_CELL_REPR_SIZE = 2 + 128 + vm::CellTraits::max_refs * (2 + 32);
+
+using Sha256BatchKernel = void (*)(td::Span<td::Slice> messages, unsigned char* digests);
+
+// sha256 of many independent messages, 32 bytes per message are written to `digests`.
+// messages are spread over avx-512 or avx2 lanes when the cpu supports them, otherwise they are hashed one by one
+auto sha256_batch(td::Span<td::Slice> messages, unsigned char* digests) -> void;
+// name of the kernel selected for this cpu: "avx512", "avx2" or "scalar"
+auto sha256_batch_kernel() -> const char*;
+// all kernels this cpu supports, best first. the first one is used by `sha256_batch`
+auto sha256_batch_kernels() -> std::vector<std::pair<const char*, Sha256BatchKernel>>;
+
+// writes representation of the cell which would be built from the slice, returns its size.
+// returns 0 if some ref has non zero level, hash of such cell depends on more than representation
+auto store_cell_repr(const vm::CellSlice& cs, unsigned char* repr) -> size_t;
+
+// collects cells which are not built yet and hashes them in one pass. cells built by the vm are
+// hashed on finalization, so only cells which are never built benefit from it
+class CellHashBatch {
+public:
+    auto size() const -> size_t { return hashes_.size(); }
+    auto reserve(size_t count) -> void;
+
+    // hash of the cell which would be built from the slice, returns its index
+    auto add(const vm::CellSlice& cs) -> size_t;
+
+    auto compute() -> std::vector<vm::CellHash>;
+
+private:
+    struct Pending {
+        size_t index;
+        size_t offset;
+        size_t size;
+    };
+
+    std::vector<unsigned char> reprs_{};
+    std::vector<Pending> pending_{};
+    std::vector<vm::CellHash> hashes_{};
+};
+
+}  // namespace ftabi
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <block/block-parse.h>
+#include <crypto/vm/cells/CellSlice.h>
+#include <td/utils/bits.h>
+
+#include <cstdint>
+#include <cstring>
+
+namespace ftabi
+{
+// read-only cursor over raw cell data which extracts fixed-width fields using 64-bit word loads
+class BitReader {
+public:
+    explicit BitReader(const vm::CellSlice& cs)
+        : data_{cs.data_bits().ptr}
+        , pos_{static_cast<unsigned>(cs.data_bits().offs)}
+        , start_{pos_}
+        , end_{pos_ + cs.size()}
+    {
+    }
+    BitReader(td::ConstBitPtr bits, unsigned size)
+        : data_{bits.ptr}
+        , pos_{static_cast<unsigned>(bits.offs)}
+        , start_{pos_}
+        , end_{pos_ + size}
+    {
+    }
+
+    auto remaining() const -> unsigned { return end_ - pos_; }
+    auto consumed() const -> unsigned { return pos_ - start_; }
+
+    auto skip(unsigned bits) -> bool
+    {
+        if (remaining() < bits) {
+            return false;
+        }
+        pos_ += bits;
+        return true;
+    }
+
+    auto fetch_ulong(unsigned bits, uint64_t& result) -> bool
+    {
+        if (bits > 64 || remaining() < bits) {
+            return false;
+        }
+        result = bits == 0 ? 0 : load_word(pos_) >> (64 - bits);
+        pos_ += bits;
+        return true;
+    }
+
+    auto fetch_long(unsigned bits, int64_t& result) -> bool
+    {
+        if (bits == 0 || bits > 64 || remaining() < bits) {
+            return false;
+        }
+        result = static_cast<int64_t>(load_word(pos_)) >> (64 - bits);
+        pos_ += bits;
+        return true;
+    }
+
+    auto fetch_bool(bool& result) -> bool
+    {
+        uint64_t bit;
+        if (!fetch_ulong(1, bit)) {
+            return false;
+        }
+        result = bit != 0;
+        return true;
+    }
+
+    auto fetch_int256(unsigned bits, bool sgnd, td::BigInt256& result) -> bool
+    {
+        if (bits <= 63 || (sgnd && bits == 64)) {
+            int64_t value;
+            if (sgnd ? !fetch_long(bits, value) : !fetch_ulong(bits, reinterpret_cast<uint64_t&>(value))) {
+                return false;
+            }
+            result = td::make_bigint(value);
+            return true;
+        }
+
+        if (bits > 257 || remaining() < bits) {
+            return false;
+        }
+        if (!result.import_bits(td::ConstBitPtr{data_, static_cast<int>(pos_)}, bits, sgnd)) {
+            return false;
+        }
+        pos_ += bits;
+        return true;
+    }
+
+    template <unsigned N>
+    auto fetch_bits_to(td::BitArray<N>& result) -> bool
+    {
+        static_assert(N % 64 == 0);
+        if (remaining() < N) {
+            return false;
+        }
+        auto* dst = result.data();
+        for (unsigned i = 0; i < N / 64; ++i) {
+            const auto word = load_word(pos_);
+            for (unsigned j = 0; j < 8; ++j) {
+                dst[i * 8 + j] = static_cast<unsigned char>(word >> (56 - j * 8));
+            }
+            pos_ += 64;
+        }
+        return true;
+    }
+
+    // addr_none$00 or addr_std$10 without anycast
+    auto fetch_address(block::StdAddress& result) -> bool
+    {
+        uint64_t tag;
+        if (!fetch_ulong(2, tag)) {
+            return false;
+        }
+        if (tag == 0b00) {
+            result = block::StdAddress{};
+            return true;
+        }
+
+        uint64_t header;
+        if (tag != 0b10 || !fetch_ulong(9, header) || (header >> 8u) != 0) {
+            return false;
+        }
+        result.workchain = static_cast<int8_t>(header & 0xffu);
+        return fetch_bits_to(result.addr);
+    }
+
+private:
+    // loads 64 bits starting at bit position `pos` into the high bits of the result
+    auto load_word(unsigned pos) const -> uint64_t
+    {
+        const auto byte_offset = pos >> 3u;
+        const auto shift = pos & 7u;
+        const auto end_byte = (end_ + 7u) >> 3u;
+
+        uint64_t word = 0;
+        if (byte_offset + 8 <= end_byte) {
+            std::memcpy(&word, data_ + byte_offset, 8);
+            word = td::bswap64(word);
+        }
+        else {
+            for (unsigned i = 0; i < 8; ++i) {
+                word <<= 8u;
+                if (byte_offset + i < end_byte) {
+                    word |= data_[byte_offset + i];
+                }
+            }
+        }
+
+        if (shift != 0) {
+            word <<= shift;
+            if (byte_offset + 8 < end_byte) {
+                word |= static_cast<uint64_t>(data_[byte_offset + 8]) >> (8u - shift);
+            }
+        }
+        return word;
+    }
+
+    const unsigned char* data_;
+    unsigned pos_;
+    unsigned start_;
+    unsigned end_;
+};
+
+}  // namespace ftabi
@@ -0,0 +1,181 @@
+#include "Emulator.hpp"
+
+#include <crypto/block/block-auto.h>
+#include <smc-envelope/GenericAccount.h>
+
+namespace ftabi
+{
+namespace
+{
+auto make_shard_account(const AccountStateInfo& account) -> td::Ref<vm::CellSlice>
+{
+    auto root = account.state_details_info.root;
+    if (root.is_null()) {
+        root = vm::CellBuilder{}.store_long(0, 1).finalize();  // account_none$0
+    }
+
+    vm::CellBuilder cb{};
+    CHECK(cb.store_ref_bool(std::move(root))                       // account:^Account
+          && cb.store_bits_bool(account.last_transaction_hash)     // last_trans_hash:bits256
+          && cb.store_long_bool(account.last_transaction_lt, 64))  // last_trans_lt:uint64
+    return vm::load_cell_slice_ref(cb.finalize());
+}
+
+auto parse_msg_prices(const block::Config& config, int idx) -> td::Result<block::MsgPrices>
+{
+    block::gen::MsgForwardPrices::Record rec;
+    auto cell = config.get_config_param(idx);
+    if (cell.is_null() || !tlb::unpack_cell(std::move(cell), rec)) {
+        return td::Status::Error(PSLICE() << "failed to fetch msg forward prices from config param " << idx);
+    }
+    return block::MsgPrices{rec.lump_price,
+                            rec.bit_price,
+                            rec.cell_price,
+                            rec.ihr_price_factor,
+                            static_cast<unsigned>(rec.first_frac),
+                            static_cast<unsigned>(rec.next_frac)};
+}
+
+}  // namespace
+
+auto TransactionEmulator::create(td::Ref<vm::Cell> config_root) -> td::Result<std::unique_ptr<TransactionEmulator>>
+{
+    TRY_RESULT(config,
+               block::Config::unpack_config(std::move(config_root),
+                                            td::Bits256::zero(),
+                                            block::Config::needCapabilities | block::Config::needLibraries | block::Config::needWorkchainInfo))
+    std::unique_ptr<TransactionEmulator> emulator{new TransactionEmulator{std::move(config)}};
+    TRY_STATUS(emulator->prepare())
+    return std::move(emulator);
+}
+
+TransactionEmulator::TransactionEmulator(std::unique_ptr<block::Config>&& config)
+    : config_{std::move(config)}
+{
+}
+
+auto TransactionEmulator::prepare() -> td::Status
+{
+    TRY_RESULT_ASSIGN(storage_prices_, config_->get_storage_prices())
+
+    for (size_t is_masterchain = 0; is_masterchain <= 1; ++is_masterchain) {
+        auto& storage_cfg = storage_phase_cfg_[is_masterchain];
+        auto& compute_cfg = compute_phase_cfg_[is_masterchain];
+
+        auto cell = config_->get_config_param(is_masterchain ? 20 : 21);
+        if (cell.is_null() || !compute_cfg.parse_GasLimitsPrices(std::move(cell), storage_cfg.freeze_due_limit, storage_cfg.delete_due_limit)) {
+            return td::Status::Error("failed to fetch gas limits and prices from config");
+        }
+        compute_cfg.libraries = std::make_unique<vm::Dictionary>(config_->get_libraries_root(), 256);
+        compute_cfg.global_config = config_->get_root_cell();
+    }
+
+    TRY_RESULT_ASSIGN(action_phase_cfg_.fwd_mc, parse_msg_prices(*config_, 24))
+    TRY_RESULT_ASSIGN(action_phase_cfg_.fwd_std, parse_msg_prices(*config_, 25))
+    action_phase_cfg_.workchains = &config_->get_workchain_list();
+    action_phase_cfg_.bounce_msg_body = config_->has_capability(ton::capBounceMsgBody) ? 256 : 0;
+    return td::Status::OK();
+}
+
+auto TransactionEmulator::emulate(const AccountStateInfo& account, td::Ref<vm::Cell> message, ton::UnixTime now, ton::LogicalTime lt) const
+    -> td::Result<EmulationResult>
+{
+    try {
+        const auto is_masterchain = account.workchain == ton::masterchainId;
+        const auto is_special = is_masterchain && config_->is_special_smartcontract(account.addr);
+
+        block::Account acc{account.workchain, account.addr.cbits()};
+        if (!acc.unpack(make_shard_account(account), td::Ref<vm::CellSlice>{}, now, is_special)) {
+            return td::Status::Error("failed to unpack account state");
+        }
+
+        auto trans = std::make_unique<block::Transaction>(acc, block::Transaction::tr_ord, lt, now, std::move(message));
+        if (!trans->unpack_input_msg(false, &action_phase_cfg_)) {
+            return td::Status::Error("failed to unpack inbound message");
+        }
+
+        const auto credit_first = !trans->in_msg_extern && !trans->bounce_enabled;
+        if (credit_first && !trans->prepare_credit_phase()) {
+            return td::Status::Error("failed to prepare credit phase");
+        }
+        if (!trans->prepare_storage_phase(storage_phase_cfg_[is_masterchain], true)) {
+            return td::Status::Error("failed to prepare storage phase");
+        }
+        if (!trans->in_msg_extern && !credit_first && !trans->prepare_credit_phase()) {
+            return td::Status::Error("failed to prepare credit phase");
+        }
+        if (!trans->prepare_compute_phase(compute_phase_cfg_[is_masterchain])) {
+            return td::Status::Error("failed to prepare compute phase");
+        }
+        if (!trans->compute_phase->accepted && trans->in_msg_extern) {
+            return td::Status::Error(PSLICE() << "inbound external message rejected with exit code " << trans->compute_phase->exit_code);
+        }
+        if (trans->compute_phase->success && !trans->prepare_action_phase(action_phase_cfg_)) {
+            return td::Status::Error("failed to prepare action phase");
+        }
+        if (trans->bounce_enabled && !trans->compute_phase->success && !trans->prepare_bounce_phase(action_phase_cfg_)) {
+            return td::Status::Error("failed to prepare bounce phase");
+        }
+        if (!trans->serialize()) {
+            return td::Status::Error("failed to serialize transaction");
+        }
+
+        EmulationResult result{};
+        result.transaction = trans->root;
+        result.total_fees = trans->total_fees;
+        result.gas_used = td::make_refint(trans->compute_phase->gas_used);
+        result.exit_code = trans->compute_phase->exit_code;
+        result.compute_success = trans->compute_phase->success;
+        result.action_success = trans->action_phase != nullptr && trans->action_phase->success;
+        result.out_messages = trans->out_msgs;
+
+        trans->commit(acc);
+        result.account = acc.total_state;
+        return std::move(result);
+    }
+    catch (vm::VmError& err) {
+        return td::Status::Error(PSLICE() << "error while emulating transaction: " << err.get_msg());
+    }
+    catch (vm::VmFatal& err) {
+        return td::Status::Error("Fatal VM error");
+    }
+}
+
+auto TransactionEmulator::emulate_call(const AccountStateInfo& account,
+                                       const Function& function,
+                                       const FunctionCall& call,
+                                       ton::UnixTime now,
+                                       ton::LogicalTime lt) const -> td::Result<EmulationResult>
+{
+    TRY_RESULT(body, function.encode_input(call))
+
+    td::Ref<vm::Cell> body_ref = body;
+    if (call.body_as_ref) {
+        body_ref = vm::CellBuilder{}.store_ref(body).finalize();
+    }
+    auto message = ton::GenericAccount::create_ext_message(block::StdAddress{account.workchain, account.addr}, {}, std::move(body_ref));
+
+    TRY_RESULT(result, emulate(account, std::move(message), now, lt))
+
+    for (auto msg : result.out_messages) {
+        auto cs = vm::load_cell_slice(msg);
+        if (block::gen::t_CommonMsgInfo.get_tag(cs) != block::gen::CommonMsgInfo::ext_out_msg_info) {
+            continue;
+        }
+
+        auto r_body = unpack_message(msg);
+        if (r_body.is_error() || r_body.ok().is_null()) {
+            continue;
+        }
+
+        auto body_cs = vm::load_cell_slice(r_body.move_as_ok());
+        if (body_cs.prefetch_ulong(32) != function.output_id()) {
+            continue;
+        }
+        TRY_RESULT_ASSIGN(result.output, function.decode_output(body_cs))
+        break;
+    }
+    return std::move(result);
+}
+
+}  // namespace ftabi
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Abi.hpp"
+
+#include <crypto/block/transaction.h>
+
+#include <array>
+#include <memory>
+
+namespace ftabi
+{
+struct EmulationResult {
+    td::Ref<vm::Cell> transaction{};
+    td::Ref<vm::Cell> account{};
+    block::CurrencyCollection total_fees{};
+    td::RefInt256 gas_used{};
+    int exit_code{};
+    bool compute_success{};
+    bool action_success{};
+    std::vector<td::Ref<vm::Cell>> out_messages{};
+    std::vector<ValueRef> output{};
+};
+
+// runs storage, credit, compute and action phases of a transaction locally.
+// config params are parsed once on creation, so one emulator can serve many checks
+class TransactionEmulator {
+public:
+    static auto create(td::Ref<vm::Cell> config_root) -> td::Result<std::unique_ptr<TransactionEmulator>>;
+
+    auto emulate(const AccountStateInfo& account, td::Ref<vm::Cell> message, ton::UnixTime now, ton::LogicalTime lt) const -> td::Result<EmulationResult>;
+    auto emulate_call(const AccountStateInfo& account, const Function& function, const FunctionCall& call, ton::UnixTime now, ton::LogicalTime lt) const
+        -> td::Result<EmulationResult>;
+
+private:
+    explicit TransactionEmulator(std::unique_ptr<block::Config>&& config);
+    auto prepare() -> td::Status;
+
+    std::unique_ptr<block::Config> config_;
+    std::vector<block::StoragePrices> storage_prices_{};
+
+    // basechain and masterchain variants of gas prices
+    std::array<block::StoragePhaseConfig, 2> storage_phase_cfg_{block::StoragePhaseConfig{&storage_prices_}, block::StoragePhaseConfig{&storage_prices_}};
+    std::array<block::ComputePhaseConfig, 2> compute_phase_cfg_{};
+    block::ActionPhaseConfig action_phase_cfg_{};
+};
+
+}  // namespace ftabi
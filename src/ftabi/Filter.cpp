@@ -0,0 +1,305 @@
+#include "Filter.hpp"
+
+#include "ValueReader.hpp"
+
+#include <algorithm>
+#include <type_traits>
+
+namespace ftabi
+{
+namespace
+{
+auto compare_result(int cmp, PredicateOp op) -> bool
+{
+    switch (op) {
+        case PredicateOp::Eq:
+            return cmp == 0;
+        case PredicateOp::Ne:
+            return cmp != 0;
+        case PredicateOp::Lt:
+            return cmp < 0;
+        case PredicateOp::Le:
+            return cmp <= 0;
+        case PredicateOp::Gt:
+            return cmp > 0;
+        case PredicateOp::Ge:
+            return cmp >= 0;
+        default:
+            return false;
+    }
+}
+
+auto is_number(ParamType type) -> bool
+{
+    switch (type) {
+        case ParamType::Uint:
+        case ParamType::Int:
+        case ParamType::Bool:
+        case ParamType::Gram:
+        case ParamType::Time:
+        case ParamType::Expire:
+            return true;
+        default:
+            return false;
+    }
+}
+
+auto check_predicate_type(const ParamRef& param, const FieldPredicate& predicate) -> td::Status
+{
+    const auto type = param->type();
+    if (predicate.op == PredicateOp::Prefix) {
+        if (type != ParamType::Bytes && type != ParamType::FixedBytes) {
+            return td::Status::Error(PSLICE() << "prefix predicate on non bytes param " << param->name());
+        }
+        return td::Status::OK();
+    }
+    if (predicate.op == PredicateOp::In) {
+        if (type != ParamType::Address || predicate.watchlist == nullptr) {
+            return td::Status::Error(PSLICE() << "watchlist predicate on non address param " << param->name());
+        }
+        return td::Status::OK();
+    }
+    if (type == ParamType::Address) {
+        if (predicate.op != PredicateOp::Eq && predicate.op != PredicateOp::Ne) {
+            return td::Status::Error(PSLICE() << "address param " << param->name() << " supports only equality");
+        }
+        return td::Status::OK();
+    }
+    if (!is_number(type) || predicate.number.is_null()) {
+        return td::Status::Error(PSLICE() << "comparison predicate on non numeric param " << param->name());
+    }
+    return td::Status::OK();
+}
+
+// numbers and addresses are read from a copy of the cursor, so several predicates may check the same param
+auto read_number(vm::CellSlice cursor, const Param& param, DecodeBudget& budget) -> td::Result<td::BigInt256>
+{
+    td::BigInt256 result{};
+    TRY_STATUS(read_inline_value(cursor, param, budget, [&](const auto& value) {
+        using V = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<V, td::BigInt256>) {
+            result = value;
+        }
+        else if constexpr (std::is_same_v<V, bool> || std::is_same_v<V, uint32_t>) {
+            result = to_bigint(static_cast<uint64_t>(value));
+        }
+        else if constexpr (std::is_same_v<V, int64_t> || std::is_same_v<V, uint64_t> || std::is_same_v<V, GramAmount>) {
+            result = to_bigint(value);
+        }
+    }))
+    return result;
+}
+
+auto address_matches(vm::CellSlice cursor, const Param& param, const block::StdAddress& address, DecodeBudget& budget) -> td::Result<bool>
+{
+    block::StdAddress value{};
+    TRY_STATUS(read_inline_value(cursor, param, budget, [&](const auto& result) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(result)>, block::StdAddress>) {
+            value = result;
+        }
+    }))
+    // addr_none is matched by the default constructed address
+    if (value.workchain == ton::workchainInvalid || address.workchain == ton::workchainInvalid) {
+        return value.workchain == address.workchain;
+    }
+    return value.workchain == address.workchain && value.addr == address.addr;
+}
+
+auto bytes_start_with(const vm::CellSlice& cursor, bool last, const std::vector<uint8_t>& prefix, DecodeBudget& budget) -> td::Result<bool>
+{
+    auto head = cursor;
+    TRY_RESULT(cell, read_cell(head, last, budget))
+
+    size_t offset = 0;
+    auto cs = vm::load_cell_slice(cell);
+    while (offset < prefix.size()) {
+        if (!budget.visit_cell()) {
+            return budget.status();
+        }
+
+        const auto available = std::min<size_t>(cs.size() / 8, prefix.size() - offset);
+        if (td::bitstring::bits_memcmp(cs.data_bits().ptr, cs.data_bits().offs, prefix.data() + offset, 0, available * 8) != 0) {
+            return false;
+        }
+        offset += available;
+
+        if (offset < prefix.size()) {
+            if (cs.size_refs() == 0) {
+                return false;
+            }
+            cs = vm::load_cell_slice(cs.prefetch_ref());
+        }
+    }
+    return true;
+}
+
+auto address_watched(vm::CellSlice& cursor, const AddressWatchlist& watchlist, DecodeBudget& budget) -> td::Result<bool>
+{
+    if (!ensure_bits(cursor, 2, budget)) {
+        return td::Status::Error("failed to fetch address. unknown format");
+    }
+    return watchlist.contains_at(cursor);
+}
+
+}  // namespace
+
+// field predicate
+
+auto FieldPredicate::compare(const std::string& field, PredicateOp op, td::RefInt256 number) -> FieldPredicate
+{
+    FieldPredicate result{};
+    result.field = field;
+    result.op = op;
+    result.number = std::move(number);
+    return result;
+}
+
+auto FieldPredicate::address_equals(const std::string& field, const block::StdAddress& address, bool equals) -> FieldPredicate
+{
+    FieldPredicate result{};
+    result.field = field;
+    result.op = equals ? PredicateOp::Eq : PredicateOp::Ne;
+    result.address = address;
+    return result;
+}
+
+auto FieldPredicate::bytes_prefix(const std::string& field, std::vector<uint8_t> prefix) -> FieldPredicate
+{
+    FieldPredicate result{};
+    result.field = field;
+    result.op = PredicateOp::Prefix;
+    result.bytes = std::move(prefix);
+    return result;
+}
+
+auto FieldPredicate::address_in(const std::string& field, std::shared_ptr<const AddressWatchlist> watchlist) -> FieldPredicate
+{
+    FieldPredicate result{};
+    result.field = field;
+    result.op = PredicateOp::In;
+    result.watchlist = std::move(watchlist);
+    return result;
+}
+
+// message filter
+
+MessageFilter::MessageFilter(td::Ref<Function> function, bool inputs, std::vector<BoundPredicate>&& predicates)
+    : function_{std::move(function)}
+    , inputs_{inputs}
+    , predicates_{std::move(predicates)}
+{
+}
+
+auto MessageFilter::for_inputs(td::Ref<Function> function, std::vector<FieldPredicate> predicates) -> td::Result<MessageFilter>
+{
+    TRY_RESULT(bound, bind(function->inputs(), std::move(predicates)))
+    return MessageFilter{std::move(function), true, std::move(bound)};
+}
+
+auto MessageFilter::for_outputs(td::Ref<Function> function, std::vector<FieldPredicate> predicates) -> td::Result<MessageFilter>
+{
+    TRY_RESULT(bound, bind(function->outputs(), std::move(predicates)))
+    return MessageFilter{std::move(function), false, std::move(bound)};
+}
+
+auto MessageFilter::bind(const std::vector<ParamRef>& params, std::vector<FieldPredicate>&& predicates) -> td::Result<std::vector<BoundPredicate>>
+{
+    std::vector<BoundPredicate> result{};
+    result.reserve(predicates.size());
+    for (auto& predicate : predicates) {
+        auto it = std::find_if(params.begin(), params.end(), [&](const ParamRef& param) { return param->name() == predicate.field; });
+        if (it == params.end()) {
+            return td::Status::Error(PSLICE() << "param " << predicate.field << " not found");
+        }
+        TRY_STATUS(check_predicate_type(*it, predicate))
+        result.emplace_back(BoundPredicate{static_cast<size_t>(it - params.begin()), std::move(predicate)});
+    }
+    std::stable_sort(result.begin(), result.end(), [](const BoundPredicate& left, const BoundPredicate& right) { return left.index < right.index; });
+    return std::move(result);
+}
+
+auto MessageFilter::matches(const vm::CellSlice& cursor) const -> td::Result<bool>
+{
+    DecodeBudget budget{};
+    return matches(cursor, budget);
+}
+
+auto MessageFilter::matches(const vm::CellSlice& cursor, DecodeBudget& budget) const -> td::Result<bool>
+{
+    const auto& params = this->params();
+
+    auto cs = cursor;
+    auto predicate = predicates_.begin();
+    for (size_t i = 0; i < params.size() && predicate != predicates_.end(); ++i) {
+        const auto& param = params[i];
+        const auto last = i + 1 == params.size();
+
+        for (; predicate != predicates_.end() && predicate->index == i; ++predicate) {
+            const auto& condition = predicate->predicate;
+
+            bool passed;
+            if (condition.op == PredicateOp::Prefix) {
+                TRY_RESULT_ASSIGN(passed, bytes_start_with(cs, last, condition.bytes, budget))
+            }
+            else if (condition.op == PredicateOp::In) {
+                TRY_RESULT_ASSIGN(passed, address_watched(cs, *condition.watchlist, budget))
+            }
+            else if (param->type() == ParamType::Address) {
+                TRY_RESULT(same, address_matches(cs, *param, condition.address, budget))
+                passed = same == (condition.op == PredicateOp::Eq);
+            }
+            else {
+                TRY_RESULT(number, read_number(cs, *param, budget))
+                passed = compare_result(number.cmp(*condition.number), condition.op);
+            }
+
+            if (!passed) {
+                return false;
+            }
+        }
+
+        // no need to skip the value after the last predicate
+        if (predicate != predicates_.end()) {
+            TRY_STATUS(skip_value(cs, *param, last, budget))
+        }
+    }
+    return true;
+}
+
+auto MessageFilter::decode_input(vm::CellSlice& cursor, bool internal) const -> td::Result<std::optional<DecodedInput>>
+{
+    if (!inputs_) {
+        return td::Status::Error("filter is bound to outputs");
+    }
+
+    DecodeBudget budget{};
+    TRY_RESULT(result, function_->decode_input_header(cursor, internal, budget))
+    if (result.function_id != function_->input_id()) {
+        return td::Status::Error("invalid input_id");
+    }
+
+    TRY_RESULT(passed, matches(cursor, budget))
+    if (!passed) {
+        return std::nullopt;
+    }
+    TRY_RESULT_ASSIGN(result.inputs, function_->decode_input_params(cursor, internal, budget))
+    return std::make_optional(std::move(result));
+}
+
+auto MessageFilter::decode_output(vm::CellSlice& cursor) const -> td::Result<std::optional<std::vector<ValueRef>>>
+{
+    if (inputs_) {
+        return td::Status::Error("filter is bound to inputs");
+    }
+    TRY_STATUS(function_->decode_output_id(cursor))
+
+    DecodeBudget budget{};
+    TRY_RESULT(passed, matches(cursor, budget))
+    if (!passed) {
+        return std::nullopt;
+    }
+    TRY_RESULT(values, function_->decode_params(cursor, budget))
+    return std::make_optional(std::move(values));
+}
+
+}  // namespace ftabi
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Abi.hpp"
+#include "Watchlist.hpp"
+
+#include <memory>
+
+namespace ftabi
+{
+enum class PredicateOp { Eq, Ne, Lt, Le, Gt, Ge, Prefix, In };
+
+// condition on a top-level param, checked on raw cell bits without decoding the value
+struct FieldPredicate {
+    static auto compare(const std::string& field, PredicateOp op, td::RefInt256 number) -> FieldPredicate;
+    static auto address_equals(const std::string& field, const block::StdAddress& address, bool equals = true) -> FieldPredicate;
+    static auto bytes_prefix(const std::string& field, std::vector<uint8_t> prefix) -> FieldPredicate;
+    static auto address_in(const std::string& field, std::shared_ptr<const AddressWatchlist> watchlist) -> FieldPredicate;
+
+    std::string field{};
+    PredicateOp op{PredicateOp::Eq};
+    td::RefInt256 number{};
+    block::StdAddress address{};
+    std::vector<uint8_t> bytes{};
+    std::shared_ptr<const AddressWatchlist> watchlist{};
+};
+
+// evaluates predicates while walking over params, so messages are decoded only when all of them pass
+class MessageFilter {
+public:
+    static auto for_inputs(td::Ref<Function> function, std::vector<FieldPredicate> predicates) -> td::Result<MessageFilter>;
+    static auto for_outputs(td::Ref<Function> function, std::vector<FieldPredicate> predicates) -> td::Result<MessageFilter>;
+
+    // cursor must point to the first param. it is not modified
+    auto matches(const vm::CellSlice& cursor) const -> td::Result<bool>;
+    auto matches(const vm::CellSlice& cursor, DecodeBudget& budget) const -> td::Result<bool>;
+
+    // decoded values or nullopt if some predicate failed. fails for a filter made for the other direction
+    auto decode_input(vm::CellSlice& cursor, bool internal) const -> td::Result<std::optional<DecodedInput>>;
+    auto decode_output(vm::CellSlice& cursor) const -> td::Result<std::optional<std::vector<ValueRef>>>;
+
+private:
+    struct BoundPredicate {
+        size_t index;
+        FieldPredicate predicate;
+    };
+
+    MessageFilter(td::Ref<Function> function, bool inputs, std::vector<BoundPredicate>&& predicates);
+    static auto bind(const std::vector<ParamRef>& params, std::vector<FieldPredicate>&& predicates) -> td::Result<std::vector<BoundPredicate>>;
+
+    auto params() const -> const std::vector<ParamRef>& { return inputs_ ? function_->inputs() : function_->outputs(); }
+
+    td::Ref<Function> function_;
+    bool inputs_;
+    // sorted by param index
+    std::vector<BoundPredicate> predicates_{};
+};
+
+}  // namespace ftabi
@@ -0,0 +1,108 @@
+#include "Message.hpp"
+
+#include <utility>
+
+namespace ftabi
+{
+namespace
+{
+auto store_info_prefix(vm::CellBuilder& cb, bool bounce) -> bool
+{
+    return cb.store_long_bool(0, 1)          // int_msg_info$0
+           && cb.store_long_bool(1, 1)       // ihr_disabled:Bool
+           && cb.store_long_bool(bounce, 1)  // bounce:Bool
+           && cb.store_long_bool(0, 1)       // bounced:Bool
+           && cb.store_long_bool(0b00, 2);   // src:addr_none
+}
+
+auto store_info_suffix(vm::CellBuilder& cb) -> bool
+{
+    return cb.store_long_bool(0, 4)       // ihr_fee:Grams
+           && cb.store_long_bool(0, 4)    // fwd_fee:Grams
+           && cb.store_long_bool(0, 64)   // created_lt:uint64
+           && cb.store_long_bool(0, 32)   // created_at:uint32
+           && cb.store_long_bool(0, 1);   // init:(Maybe ...) = nothing
+}
+
+auto store_destination(vm::CellBuilder& cb, const InternalMessageParams& params) -> bool
+{
+    return cb.store_long_bool(0b100, 3)                              // addr_std$10 anycast:nothing
+           && cb.store_long_bool(params.destination.workchain, 8)       // workchain_id:int8
+           && cb.store_bits_bool(params.destination.addr)               // address:bits256
+           && block::tlb::t_Grams.store_integer_ref(cb, params.value)  // value:CurrencyCollection
+           && cb.store_long_bool(0, 1);                                 // other:ExtraCurrencyCollection
+}
+
+auto store_body(vm::CellBuilder& cb, BuilderData&& body, bool body_as_ref) -> bool
+{
+    const auto fits = !body_as_ref && cb.can_extend_by(1 + body->size(), body->size_refs());
+    if (fits) {
+        return cb.store_long_bool(0, 1) && cb.append_data_cell_bool(std::move(body));
+    }
+    return cb.store_long_bool(1, 1) && cb.store_ref_bool(std::move(body));
+}
+
+auto encode_body(const Function& function, const FunctionCall& call) -> td::Result<BuilderData>
+{
+    if (!call.internal) {
+        return td::Status::Error("internal message needs an internal call");
+    }
+    return function.encode_input(HeaderSlots{}, call.inputs, true, std::nullopt);
+}
+
+}  // namespace
+
+auto create_internal_message(const Function& function, const FunctionCall& call, const InternalMessageParams& params) -> td::Result<BuilderData>
+{
+    TRY_RESULT(body, encode_body(function, call))
+
+    vm::CellBuilder cb{};
+    if (!(store_info_prefix(cb, params.bounce) && store_destination(cb, params) && store_info_suffix(cb) &&
+          store_body(cb, std::move(body), call.body_as_ref))) {
+        return td::Status::Error("failed to build internal message");
+    }
+    return cb.finalize();
+}
+
+InternalMessageBatch::InternalMessageBatch(td::Ref<Function> function, uint8_t mode)
+    : function_{std::move(function)}
+    , mode_{mode}
+{
+    CHECK(store_info_prefix(prefix_bounce_, true) && store_info_prefix(prefix_no_bounce_, false) && store_info_suffix(suffix_))
+}
+
+auto InternalMessageBatch::add(const FunctionCall& call, const InternalMessageParams& params) -> td::Status
+{
+    TRY_RESULT(body, encode_body(*function_, call))
+
+    const auto& prefix = params.bounce ? prefix_bounce_ : prefix_no_bounce_;
+
+    vm::CellBuilder cb{};
+    if (!(cb.store_bits_bool(prefix.data_bits(), prefix.size()) && store_destination(cb, params) &&
+          cb.store_bits_bool(suffix_.data_bits(), suffix_.size()) && store_body(cb, std::move(body), call.body_as_ref))) {
+        return td::Status::Error("failed to build internal message");
+    }
+
+    if (current_.size_refs() == vm::CellTraits::max_refs) {
+        send_list_.emplace_back(current_.finalize());
+    }
+    CHECK(current_.store_long_bool(mode_, 8) && current_.store_ref_bool(cb.finalize()))
+    ++size_;
+    return td::Status::OK();
+}
+
+auto InternalMessageBatch::add(const td::Ref<FunctionCall>& call, const InternalMessageParams& params) -> td::Status
+{
+    return add(*call, params);
+}
+
+auto InternalMessageBatch::finish() -> std::vector<BuilderData>
+{
+    if (current_.size_refs() > 0) {
+        send_list_.emplace_back(current_.finalize());
+    }
+    size_ = 0;
+    return std::exchange(send_list_, {});
+}
+
+}  // namespace ftabi
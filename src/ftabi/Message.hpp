@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Abi.hpp"
+
+namespace ftabi
+{
+struct InternalMessageParams {
+    block::StdAddress destination{};
+    td::RefInt256 value{td::make_refint(0)};
+    bool bounce{true};
+};
+
+// int_msg_info$0 with src, fees, created_lt and created_at left for the sender to fill.
+// the call must be internal, its body is stored by reference if `body_as_ref` is set or it doesn't fit
+auto create_internal_message(const Function& function, const FunctionCall& call, const InternalMessageParams& params) -> td::Result<BuilderData>;
+
+// builds messages with shared prefix and suffix bits straight into send list cells
+// of `mode:uint8 ^Message` entries, up to four messages per cell
+class InternalMessageBatch {
+public:
+    explicit InternalMessageBatch(td::Ref<Function> function, uint8_t mode);
+
+    auto add(const FunctionCall& call, const InternalMessageParams& params) -> td::Status;
+    auto add(const td::Ref<FunctionCall>& call, const InternalMessageParams& params) -> td::Status;
+
+    // number of added messages
+    auto size() const -> size_t { return size_; }
+
+    // send list cells, the batch is empty afterwards
+    auto finish() -> std::vector<BuilderData>;
+
+private:
+    td::Ref<Function> function_;
+    uint8_t mode_;
+    vm::CellBuilder prefix_bounce_{};
+    vm::CellBuilder prefix_no_bounce_{};
+    vm::CellBuilder suffix_{};
+    vm::CellBuilder current_{};
+    std::vector<BuilderData> send_list_{};
+    size_t size_{};
+};
+
+}  // namespace ftabi
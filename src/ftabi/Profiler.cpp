@@ -0,0 +1,198 @@
+#include "Profiler.hpp"
+
+#include <td/utils/misc.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+namespace ftabi
+{
+namespace
+{
+constexpr std::string_view EXECUTE_PREFIX = "execute ";
+constexpr std::string_view GAS_PREFIX = "gas remaining: ";
+constexpr std::string_view LOCATION_PREFIX = "code cell hash: ";
+constexpr std::string_view OFFSET_PREFIX = " offset: ";
+
+auto merge_stats(InstructionStats& target, const InstructionStats& other) -> void
+{
+    target.count += other.count;
+    target.gas += other.gas;
+    target.time += other.time;
+}
+
+auto trim_line(td::CSlice slice) -> std::string_view
+{
+    std::string_view line{slice.data(), slice.size()};
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+auto find_prefix(std::string_view line, std::string_view prefix) -> std::optional<std::string_view>
+{
+    const auto pos = line.find(prefix);
+    if (pos == std::string_view::npos) {
+        return std::nullopt;
+    }
+    return line.substr(pos + prefix.size());
+}
+
+}  // namespace
+
+// execution profile
+
+auto ExecutionProfile::merge(const ExecutionProfile& other) -> void
+{
+    runs += other.runs;
+    merge_stats(total, other.total);
+    for (const auto& [opcode, stats] : other.opcodes) {
+        merge_stats(opcodes[opcode], stats);
+    }
+    for (const auto& [location, stats] : other.locations) {
+        merge_stats(locations[location], stats);
+    }
+    for (const auto& [frame, stats] : other.frames) {
+        merge_stats(frames[frame], stats);
+    }
+}
+
+// execution tracer
+
+ExecutionTracer::ExecutionTracer(int64_t gas_limit)
+    : gas_limit_{gas_limit}
+    , gas_remaining_{gas_limit}
+    , started_at_{std::chrono::steady_clock::now()}
+{
+}
+
+auto ExecutionTracer::vm_log() -> vm::VmLog
+{
+    vm::VmLog log{};
+    log.log_interface = this;
+    log.log_options = td::LogOptions{VERBOSITY_NAME(DEBUG), false, false};
+    log.log_mask |= vm::VmLog::ExecLocation | vm::VmLog::GasRemaining;
+    return log;
+}
+
+auto ExecutionTracer::finish(int64_t gas_consumed) -> ExecutionProfile
+{
+    const auto now = std::chrono::steady_clock::now();
+    flush_instruction(gas_limit_ - gas_consumed, now);
+
+    profile_.runs = 1;
+    profile_.total.gas = gas_consumed;
+    profile_.total.time = std::chrono::duration<double>(now - started_at_).count();
+    return std::move(profile_);
+}
+
+void ExecutionTracer::append(td::CSlice slice, int /*log_level*/)
+{
+    const auto line = trim_line(slice);
+    const auto now = std::chrono::steady_clock::now();
+
+    if (auto location = find_prefix(line, LOCATION_PREFIX); location.has_value()) {
+        const auto offset_pos = location->find(OFFSET_PREFIX);
+        if (offset_pos == std::string_view::npos) {
+            next_location_ = std::string{*location};
+        }
+        else {
+            next_location_ = std::string{location->substr(0, offset_pos)} + ":" + std::string{location->substr(offset_pos + OFFSET_PREFIX.size())};
+        }
+    }
+    else if (auto gas = find_prefix(line, GAS_PREFIX); gas.has_value()) {
+        auto gas_remaining = td::to_integer_safe<int64_t>(td::Slice{gas->data(), gas->size()});
+        if (gas_remaining.is_ok()) {
+            flush_instruction(gas_remaining.ok(), now);
+        }
+        location_ = std::move(next_location_);
+        next_location_.clear();
+    }
+    else if (auto opcode = find_prefix(line, EXECUTE_PREFIX); opcode.has_value()) {
+        opcode_ = std::string{*opcode};
+        opcode_started_at_ = now;
+    }
+}
+
+auto ExecutionTracer::flush_instruction(int64_t gas_remaining, std::chrono::steady_clock::time_point now) -> void
+{
+    if (opcode_.empty()) {
+        gas_remaining_ = gas_remaining;
+        return;
+    }
+
+    InstructionStats stats{};
+    stats.count = 1;
+    stats.gas = gas_remaining_ - gas_remaining;
+    stats.time = std::chrono::duration<double>(now - opcode_started_at_).count();
+
+    merge_stats(profile_.opcodes[opcode_], stats);
+    if (!location_.empty()) {
+        merge_stats(profile_.locations[location_], stats);
+        merge_stats(profile_.frames[location_ + ";" + opcode_], stats);
+    }
+    else {
+        merge_stats(profile_.frames[opcode_], stats);
+    }
+    ++profile_.total.count;
+
+    gas_remaining_ = gas_remaining;
+    opcode_.clear();
+}
+
+// execution profiler
+
+auto ExecutionProfiler::record(const std::string& contract, const std::string& method, const ExecutionProfile& profile) -> void
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    profiles_[std::make_pair(contract, method)].merge(profile);
+}
+
+auto ExecutionProfiler::reset() -> void
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    profiles_.clear();
+}
+
+auto ExecutionProfiler::to_table() const -> std::string
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    std::ostringstream ss{};
+    ss << std::left << std::setw(72) << "contract:method" << std::right << std::setw(10) << "runs" << std::setw(16) << "instructions"
+       << std::setw(16) << "gas" << std::setw(14) << "time, ms" << "\n";
+
+    for (const auto& [key, profile] : profiles_) {
+        ss << std::left << std::setw(72) << (key.first + ":" + key.second) << std::right << std::setw(10) << profile.runs << std::setw(16)
+           << profile.total.count << std::setw(16) << profile.total.gas << std::setw(14) << std::fixed << std::setprecision(3)
+           << profile.total.time * 1000.0 << "\n";
+
+        std::vector<std::pair<std::string, InstructionStats>> opcodes{profile.opcodes.begin(), profile.opcodes.end()};
+        std::sort(opcodes.begin(), opcodes.end(), [](const auto& left, const auto& right) { return left.second.gas > right.second.gas; });
+        for (const auto& [opcode, stats] : opcodes) {
+            ss << "  " << std::left << std::setw(80) << opcode << std::right << std::setw(16) << stats.count << std::setw(16) << stats.gas
+               << std::setw(14) << std::fixed << std::setprecision(3) << stats.time * 1000.0 << "\n";
+        }
+    }
+    return ss.str();
+}
+
+auto ExecutionProfiler::to_folded_stacks() const -> std::string
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    std::ostringstream ss{};
+    for (const auto& [key, profile] : profiles_) {
+        for (const auto& [frame, stats] : profile.frames) {
+            ss << key.first << ";" << key.second << ";" << frame << " " << stats.gas << "\n";
+        }
+    }
+    return ss.str();
+}
+
+}  // namespace ftabi
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <crypto/vm/vm.h>
+#include <td/utils/logging.h>
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace ftabi
+{
+struct InstructionStats {
+    uint64_t count{};
+    int64_t gas{};
+    double time{};
+};
+
+struct ExecutionProfile {
+    auto merge(const ExecutionProfile& other) -> void;
+
+    uint64_t runs{};
+    InstructionStats total{};
+    std::map<std::string, InstructionStats> opcodes{};
+    std::map<std::string, InstructionStats> locations{};
+    std::map<std::string, InstructionStats> frames{};
+};
+
+// collects stats of a single vm run from the lines it writes into its log
+class ExecutionTracer final : public td::LogInterface {
+public:
+    explicit ExecutionTracer(int64_t gas_limit);
+
+    auto vm_log() -> vm::VmLog;
+    auto finish(int64_t gas_consumed) -> ExecutionProfile;
+
+    void append(td::CSlice slice, int log_level) final;
+
+private:
+    auto flush_instruction(int64_t gas_remaining, std::chrono::steady_clock::time_point now) -> void;
+
+    ExecutionProfile profile_{};
+    int64_t gas_limit_{};
+    int64_t gas_remaining_{};
+    std::string location_{};
+    std::string next_location_{};
+    std::string opcode_{};
+    std::chrono::steady_clock::time_point started_at_{};
+    std::chrono::steady_clock::time_point opcode_started_at_{};
+};
+
+// aggregates profiles of many local runs grouped by contract and method
+class ExecutionProfiler {
+public:
+    auto record(const std::string& contract, const std::string& method, const ExecutionProfile& profile) -> void;
+    auto reset() -> void;
+
+    auto to_table() const -> std::string;
+    auto to_folded_stacks() const -> std::string;
+
+private:
+    mutable std::mutex mutex_{};
+    std::map<std::pair<std::string, std::string>, ExecutionProfile> profiles_{};
+};
+
+}  // namespace ftabi
@@ -0,0 +1,248 @@
+#include "Registry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <set>
+#include <vector>
+
+namespace ftabi
+{
+namespace
+{
+constexpr size_t MAX_READER_THREADS = 1024;
+constexpr uint64_t IDLE_EPOCH = 0;
+constexpr size_t NO_SLOT = std::numeric_limits<size_t>::max();
+
+// epoch based reclamation shared by all registries
+class EpochDomain {
+public:
+    static auto instance() -> EpochDomain&
+    {
+        static EpochDomain domain{};
+        return domain;
+    }
+
+    auto enter() -> void
+    {
+        auto& local = local_state();
+        if (local.depth++ != 0) {
+            return;
+        }
+        if (local.slot != NO_SLOT) {
+            slots_[local.slot].epoch.store(global_epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            return;
+        }
+
+        // threads which didn't get a slot announce their epoch under the lock
+        std::lock_guard<std::mutex> lock{overflow_mutex_};
+        local.overflow_epoch = global_epoch_.load(std::memory_order_seq_cst);
+        overflow_epochs_.insert(local.overflow_epoch);
+    }
+
+    auto leave() -> void
+    {
+        auto& local = local_state();
+        if (--local.depth != 0) {
+            return;
+        }
+        if (local.slot != NO_SLOT) {
+            slots_[local.slot].epoch.store(IDLE_EPOCH, std::memory_order_release);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock{overflow_mutex_};
+        overflow_epochs_.erase(overflow_epochs_.find(local.overflow_epoch));
+    }
+
+    auto retire(RegistrySnapshot* snapshot) -> void
+    {
+        const auto epoch = global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+        std::lock_guard<std::mutex> lock{retired_mutex_};
+        retired_.emplace_back(epoch, snapshot);
+    }
+
+    auto collect() -> size_t
+    {
+        auto min_epoch = std::numeric_limits<uint64_t>::max();
+        for (const auto& slot : slots_) {
+            const auto epoch = slot.epoch.load(std::memory_order_seq_cst);
+            if (epoch != IDLE_EPOCH && epoch < min_epoch) {
+                min_epoch = epoch;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock{overflow_mutex_};
+            if (!overflow_epochs_.empty()) {
+                min_epoch = std::min(min_epoch, *overflow_epochs_.begin());
+            }
+        }
+
+        std::vector<RegistrySnapshot*> reclaimed{};
+        {
+            std::lock_guard<std::mutex> lock{retired_mutex_};
+            auto it = retired_.begin();
+            while (it != retired_.end()) {
+                if (it->first < min_epoch) {
+                    reclaimed.emplace_back(it->second);
+                    it = retired_.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+
+        for (auto* snapshot : reclaimed) {
+            delete snapshot;
+        }
+        return reclaimed.size();
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE_EPOCH};
+        std::atomic<bool> used{false};
+    };
+
+    struct LocalState {
+        explicit LocalState(EpochDomain& domain)
+            : domain{domain}
+            , slot{domain.acquire_slot()}
+        {
+        }
+        ~LocalState()
+        {
+            if (slot != NO_SLOT) {
+                domain.slots_[slot].used.store(false, std::memory_order_release);
+            }
+        }
+
+        EpochDomain& domain;
+        size_t slot;
+        size_t depth{};
+        uint64_t overflow_epoch{IDLE_EPOCH};
+    };
+
+    auto local_state() -> LocalState&
+    {
+        thread_local LocalState local{*this};
+        return local;
+    }
+
+    // NO_SLOT when all slots are taken, the thread then uses the locked path for its lifetime
+    auto acquire_slot() -> size_t
+    {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            bool expected = false;
+            if (!slots_[i].used.load(std::memory_order_relaxed) && slots_[i].used.compare_exchange_strong(expected, true)) {
+                return i;
+            }
+        }
+        return NO_SLOT;
+    }
+
+    std::atomic<uint64_t> global_epoch_{1};
+    std::array<Slot, MAX_READER_THREADS> slots_{};
+    std::mutex retired_mutex_{};
+    std::vector<std::pair<uint64_t, RegistrySnapshot*>> retired_{};
+    std::mutex overflow_mutex_{};
+    std::multiset<uint64_t> overflow_epochs_{};
+};
+
+}  // namespace
+
+// registry snapshot
+
+auto RegistrySnapshot::find_by_code_hash(const vm::CellHash& code_hash) const -> td::Ref<Contract>
+{
+    auto it = by_code_hash.find(code_hash);
+    return it != by_code_hash.end() ? it->second : td::Ref<Contract>{};
+}
+
+auto RegistrySnapshot::find_by_address(const block::StdAddress& address) const -> td::Ref<Contract>
+{
+    auto it = by_address.find(std::make_pair(address.workchain, address.addr));
+    return it != by_address.end() ? it->second : td::Ref<Contract>{};
+}
+
+// abi registry
+
+AbiRegistry::ReadGuard::ReadGuard(const AbiRegistry& registry)
+{
+    EpochDomain::instance().enter();
+    snapshot_ = registry.current_.load(std::memory_order_seq_cst);
+}
+
+AbiRegistry::ReadGuard::~ReadGuard()
+{
+    EpochDomain::instance().leave();
+}
+
+AbiRegistry::AbiRegistry()
+    : current_{new RegistrySnapshot{}}
+{
+}
+
+AbiRegistry::~AbiRegistry()
+{
+    EpochDomain::instance().retire(current_.exchange(nullptr));
+    EpochDomain::instance().collect();
+}
+
+auto AbiRegistry::find_by_code_hash(const vm::CellHash& code_hash) const -> td::Ref<Contract>
+{
+    return read()->find_by_code_hash(code_hash);
+}
+
+auto AbiRegistry::find_by_address(const block::StdAddress& address) const -> td::Ref<Contract>
+{
+    return read()->find_by_address(address);
+}
+
+auto AbiRegistry::version() const -> uint64_t
+{
+    return read()->version;
+}
+
+auto AbiRegistry::publish_code_hash(const vm::CellHash& code_hash, td::Ref<Contract> contract) -> void
+{
+    update([&](RegistrySnapshot& snapshot) { snapshot.by_code_hash[code_hash] = std::move(contract); });
+}
+
+auto AbiRegistry::publish_address(const block::StdAddress& address, td::Ref<Contract> contract) -> void
+{
+    update([&](RegistrySnapshot& snapshot) { snapshot.by_address[std::make_pair(address.workchain, address.addr)] = std::move(contract); });
+}
+
+auto AbiRegistry::remove_code_hash(const vm::CellHash& code_hash) -> void
+{
+    update([&](RegistrySnapshot& snapshot) { snapshot.by_code_hash.erase(code_hash); });
+}
+
+auto AbiRegistry::remove_address(const block::StdAddress& address) -> void
+{
+    update([&](RegistrySnapshot& snapshot) { snapshot.by_address.erase(std::make_pair(address.workchain, address.addr)); });
+}
+
+auto AbiRegistry::update(const std::function<void(RegistrySnapshot&)>& modify) -> void
+{
+    {
+        std::lock_guard<std::mutex> lock{write_mutex_};
+
+        // snapshot contents are immutable, so copying maps only bumps contract refcounts
+        auto* next = new RegistrySnapshot{*current_.load(std::memory_order_acquire)};
+        modify(*next);
+        ++next->version;
+
+        EpochDomain::instance().retire(current_.exchange(next, std::memory_order_seq_cst));
+    }
+    EpochDomain::instance().collect();
+}
+
+auto AbiRegistry::collect() -> size_t
+{
+    return EpochDomain::instance().collect();
+}
+
+}  // namespace ftabi
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Abi.hpp"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace ftabi
+{
+struct RegistrySnapshot {
+    auto find_by_code_hash(const vm::CellHash& code_hash) const -> td::Ref<Contract>;
+    auto find_by_address(const block::StdAddress& address) const -> td::Ref<Contract>;
+
+    uint64_t version{};
+    std::map<vm::CellHash, td::Ref<Contract>> by_code_hash{};
+    std::map<std::pair<ton::WorkchainId, ton::StdSmcAddress>, td::Ref<Contract>> by_address{};
+};
+
+// registry of contract abis which can be replaced while other threads decode with them.
+// readers announce the current epoch and read the published snapshot, old snapshots are deleted
+// only after all readers which could see them have left. each thread claims one of 1024 epoch
+// slots with a compare-and-swap scan on its first read, so reads are lock-free but not wait-free.
+// threads beyond that announce their epochs under a mutex instead
+class AbiRegistry {
+public:
+    class ReadGuard {
+    public:
+        explicit ReadGuard(const AbiRegistry& registry);
+        ~ReadGuard();
+        ReadGuard(const ReadGuard&) = delete;
+        auto operator=(const ReadGuard&) -> ReadGuard& = delete;
+
+        auto operator->() const -> const RegistrySnapshot* { return snapshot_; }
+        auto operator*() const -> const RegistrySnapshot& { return *snapshot_; }
+
+    private:
+        const RegistrySnapshot* snapshot_;
+    };
+
+    AbiRegistry();
+    ~AbiRegistry();
+    AbiRegistry(const AbiRegistry&) = delete;
+    auto operator=(const AbiRegistry&) -> AbiRegistry& = delete;
+
+    auto read() const -> ReadGuard { return ReadGuard{*this}; }
+    auto find_by_code_hash(const vm::CellHash& code_hash) const -> td::Ref<Contract>;
+    auto find_by_address(const block::StdAddress& address) const -> td::Ref<Contract>;
+    auto version() const -> uint64_t;
+
+    auto publish_code_hash(const vm::CellHash& code_hash, td::Ref<Contract> contract) -> void;
+    auto publish_address(const block::StdAddress& address, td::Ref<Contract> contract) -> void;
+    auto remove_code_hash(const vm::CellHash& code_hash) -> void;
+    auto remove_address(const block::StdAddress& address) -> void;
+    auto update(const std::function<void(RegistrySnapshot&)>& modify) -> void;
+
+    // deletes retired snapshots which are no longer visible to any reader
+    static auto collect() -> size_t;
+
+private:
+    std::atomic<RegistrySnapshot*> current_;
+    std::mutex write_mutex_{};
+};
+
+}  // namespace ftabi
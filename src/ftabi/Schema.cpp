@@ -0,0 +1,162 @@
+#include "Schema.hpp"
+
+namespace ftabi
+{
+namespace
+{
+auto param_size(const Param& param) -> uint32_t
+{
+    switch (param.type()) {
+        case ParamType::Uint:
+        case ParamType::Int:
+            return static_cast<uint32_t>(param.bit_len());
+        case ParamType::FixedBytes:
+            return static_cast<uint32_t>(static_cast<const ParamFixedBytes&>(param).size);
+        case ParamType::FixedArray:
+            return static_cast<uint32_t>(static_cast<const ParamFixedArray&>(param).size);
+        default:
+            return 0;
+    }
+}
+
+auto param_children(const Param& param) -> std::vector<ParamRef>
+{
+    switch (param.type()) {
+        case ParamType::Tuple:
+            return static_cast<const ParamTuple&>(param).items;
+        case ParamType::Array:
+            return {static_cast<const ParamArray&>(param).param};
+        case ParamType::FixedArray:
+            return {static_cast<const ParamFixedArray&>(param).param};
+        case ParamType::Map: {
+            const auto& map = static_cast<const ParamMap&>(param);
+            return {map.key, map.value};
+        }
+        default:
+            return {};
+    }
+}
+
+// rebuilds the param on top of the shared children, reuses it if they are the same already
+auto with_children(const ParamRef& param, std::vector<ParamRef>&& children) -> ParamRef
+{
+    const auto original = param_children(*param);
+    bool same = true;
+    for (size_t i = 0; i < children.size(); ++i) {
+        same &= children[i].get() == original[i].get();
+    }
+    if (same) {
+        return param;
+    }
+
+    const auto& name = param->interned_name();
+    switch (param->type()) {
+        case ParamType::Tuple:
+            return ParamRef{ParamTuple{name, std::move(children)}};
+        case ParamType::Array:
+            return ParamRef{ParamArray{name, std::move(children[0])}};
+        case ParamType::FixedArray:
+            return ParamRef{ParamFixedArray{name, std::move(children[0]), param_size(*param)}};
+        case ParamType::Map:
+            return ParamRef{ParamMap{name, std::move(children[0]), std::move(children[1])}};
+        default:
+            return param;
+    }
+}
+
+}  // namespace
+
+auto SchemaStore::share(const ParamRef& param) -> ParamRef
+{
+    auto children = param_children(*param);
+    for (auto& child : children) {
+        child = share(child);
+    }
+    return *params_.emplace(with_children(param, std::move(children))).first;
+}
+
+auto SchemaStore::share(const std::vector<ParamRef>& params) -> std::vector<ParamRef>
+{
+    std::vector<ParamRef> result{};
+    result.reserve(params.size());
+    for (const auto& param : params) {
+        result.emplace_back(share(param));
+    }
+    return result;
+}
+
+auto SchemaStore::share(const td::Ref<Function>& function) -> td::Result<td::Ref<Function>>
+{
+    auto name = std::string{function->name()};
+    auto header = share(function->header());
+    auto inputs = share(function->inputs());
+    auto outputs = share(function->outputs());
+    if (function->has_fixed_layout()) {
+        return Function::with_fixed_layout(std::move(name), std::move(header), std::move(inputs), std::move(outputs), function->input_id(),
+                                           function->output_id());
+    }
+    return td::Ref<Function>{true, std::move(name), std::move(header), std::move(inputs), std::move(outputs), function->input_id(), function->output_id()};
+}
+
+auto SchemaStore::share(const td::Ref<Contract>& contract) -> td::Result<td::Ref<Contract>>
+{
+    std::vector<td::Ref<Function>> functions{};
+    functions.reserve(contract->functions().size());
+    for (const auto& function : contract->functions()) {
+        TRY_RESULT(shared, share(function))
+        functions.emplace_back(std::move(shared));
+    }
+    return td::Ref<Contract>{true, std::string{contract->name()}, std::move(functions)};
+}
+
+auto SchemaStore::collect() -> size_t
+{
+    // dropping a param releases its children, so unused subtrees are dropped level by level
+    size_t result = 0;
+    for (auto changed = true; changed;) {
+        changed = false;
+        for (auto it = params_.begin(); it != params_.end();) {
+            if (it->is_unique()) {
+                it = params_.erase(it);
+                ++result;
+                changed = true;
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+    return result;
+}
+
+auto SchemaStore::ParamHash::operator()(const ParamRef& param) const -> size_t
+{
+    auto result = std::hash<const std::string*>{}(&param->name());
+    const auto combine = [&](size_t value) { result ^= value + 0x9e3779b97f4a7c15ull + (result << 6u) + (result >> 2u); };
+    combine(static_cast<size_t>(param->type()));
+    combine(param_size(*param));
+    for (const auto& child : param_children(*param)) {
+        combine(std::hash<const Param*>{}(child.get()));
+    }
+    return result;
+}
+
+auto SchemaStore::ParamEqual::operator()(const ParamRef& left, const ParamRef& right) const -> bool
+{
+    if (left->interned_name() != right->interned_name() || left->type() != right->type() || param_size(*left) != param_size(*right)) {
+        return false;
+    }
+    const auto left_children = param_children(*left);
+    const auto right_children = param_children(*right);
+    if (left_children.size() != right_children.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < left_children.size(); ++i) {
+        if (left_children[i].get() != right_children[i].get()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace ftabi
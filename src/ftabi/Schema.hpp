@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Abi.hpp"
+
+#include <unordered_set>
+
+namespace ftabi
+{
+// hash-consing of params shared by many abis. structurally identical params (names included)
+// become the same object, so equal subtrees of different abis are stored once. params are still
+// separate objects, subtrees which differ only in names are not shared.
+// the store keeps params alive until `collect` is called, e.g. after abis were replaced in the registry.
+// sharing and collecting are not thread safe, shared params may be used from any thread
+class SchemaStore {
+public:
+    auto share(const ParamRef& param) -> ParamRef;
+    auto share(const std::vector<ParamRef>& params) -> std::vector<ParamRef>;
+    auto share(const td::Ref<Function>& function) -> td::Result<td::Ref<Function>>;
+    auto share(const td::Ref<Contract>& contract) -> td::Result<td::Ref<Contract>>;
+
+    // drops params which are used only by the store, returns how many were dropped
+    auto collect() -> size_t;
+
+    // number of distinct params
+    auto size() const -> size_t { return params_.size(); }
+
+private:
+    // params are compared by name, type, size and children, which are shared already
+    struct ParamHash {
+        auto operator()(const ParamRef& param) const -> size_t;
+    };
+    struct ParamEqual {
+        auto operator()(const ParamRef& left, const ParamRef& right) const -> bool;
+    };
+
+    std::unordered_set<ParamRef, ParamHash, ParamEqual> params_{};
+};
+
+}  // namespace ftabi
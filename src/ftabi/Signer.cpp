@@ -0,0 +1,199 @@
+#include "Signer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace ftabi
+{
+// local signer
+
+auto LocalSigner::create(const td::Ed25519::PrivateKey& private_key) -> td::Result<LocalSigner>
+{
+    TRY_RESULT(signing_key, SigningKey::create(private_key))
+    return LocalSigner{std::move(signing_key)};
+}
+
+LocalSigner::LocalSigner(td::Ref<SigningKey> signing_key)
+    : signing_key_{std::move(signing_key)}
+{
+}
+
+auto LocalSigner::sign(const vm::CellHash& hash) -> std::future<SignatureResult>
+{
+    std::promise<SignatureResult> promise{};
+    promise.set_value(signing_key_->sign(hash.as_slice()));
+    return promise.get_future();
+}
+
+// batching signer
+
+namespace
+{
+// promises of a batch sent to the transport. they get an error if the callback is destroyed without being called
+struct PendingBatch {
+    explicit PendingBatch(std::vector<std::promise<SignatureResult>>&& promises)
+        : promises{std::move(promises)}
+    {
+    }
+
+    ~PendingBatch()
+    {
+        if (!completed.exchange(true)) {
+            for (auto& promise : promises) {
+                promise.set_value(td::Status::Error("signer dropped the batch"));
+            }
+        }
+    }
+
+    // only the first call sets the results
+    auto complete(std::vector<SignatureResult>&& signatures) -> void
+    {
+        if (completed.exchange(true)) {
+            return;
+        }
+        for (size_t i = 0; i < promises.size(); ++i) {
+            if (i < signatures.size()) {
+                promises[i].set_value(std::move(signatures[i]));
+            }
+            else {
+                promises[i].set_value(td::Status::Error("signer returned too few signatures"));
+            }
+        }
+    }
+
+    std::vector<std::promise<SignatureResult>> promises;
+    std::atomic<bool> completed{false};
+};
+
+}  // namespace
+
+BatchingSigner::BatchingSigner(Transport transport, size_t max_batch_size)
+    : transport_{std::move(transport)}
+    , max_batch_size_{std::max<size_t>(max_batch_size, 1)}
+{
+}
+
+BatchingSigner::~BatchingSigner()
+{
+    flush();
+}
+
+auto BatchingSigner::sign(const vm::CellHash& hash) -> std::future<SignatureResult>
+{
+    std::optional<Batch> full{};
+    std::future<SignatureResult> result{};
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        pending_.hashes.emplace_back(hash);
+        result = pending_.promises.emplace_back().get_future();
+        if (pending_.hashes.size() >= max_batch_size_) {
+            full = std::exchange(pending_, Batch{});
+        }
+    }
+
+    if (full.has_value()) {
+        send(std::move(*full));
+    }
+    return result;
+}
+
+auto BatchingSigner::flush() -> void
+{
+    Batch batch{};
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        batch = std::exchange(pending_, Batch{});
+    }
+
+    if (!batch.hashes.empty()) {
+        send(std::move(batch));
+    }
+}
+
+auto BatchingSigner::send(Batch&& batch) -> void
+{
+    auto pending = std::make_shared<PendingBatch>(std::move(batch.promises));
+    transport_(std::move(batch.hashes), [pending](std::vector<SignatureResult>&& signatures) { pending->complete(std::move(signatures)); });
+}
+
+// signing pipeline
+
+SigningPipeline::SigningPipeline(Signer& signer)
+    : signer_{signer}
+{
+}
+
+auto SigningPipeline::submit(const Function& function, const HeaderSlots& header, const InputValues& inputs) -> td::Status
+{
+    auto call = td::Ref<FunctionCall>{true, HeaderSlots{header}, InputValues{inputs}, false, std::nullopt};
+    auto unsigned_calls = function.create_unsigned_calls({std::move(call)}, true);
+    TRY_RESULT(unsigned_call, std::move(unsigned_calls.front()))
+    auto signature = signer_.sign(unsigned_call.hash);
+    queue_.emplace_back(Entry{std::move(unsigned_call), std::move(signature)});
+    return td::Status::OK();
+}
+
+auto SigningPipeline::submit(const Function& function, const FunctionCall& call) -> td::Status
+{
+    if (call.internal) {
+        return td::Status::Error("internal calls are not signed");
+    }
+    if (call.header_slots.has_value()) {
+        return submit(function, *call.header_slots, call.inputs);
+    }
+    TRY_RESULT(header_slots, function.make_header_slots(call.header))
+    return submit(function, header_slots, call.inputs);
+}
+
+auto SigningPipeline::submit(const Function& function, const std::vector<td::Ref<FunctionCall>>& calls) -> void
+{
+    auto unsigned_calls = function.create_unsigned_calls(calls, true);
+    for (size_t i = 0; i < calls.size(); ++i) {
+        auto& unsigned_call = unsigned_calls[i];
+        if (unsigned_call.is_ok() && calls[i]->internal) {
+            unsigned_call = td::Status::Error("internal calls are not signed");
+        }
+
+        if (unsigned_call.is_error()) {
+            std::promise<SignatureResult> failed{};
+            failed.set_value(unsigned_call.move_as_error());
+            queue_.emplace_back(Entry{UnsignedCall{}, failed.get_future()});
+            continue;
+        }
+
+        auto signature = signer_.sign(unsigned_call.ok().hash);
+        queue_.emplace_back(Entry{unsigned_call.move_as_ok(), std::move(signature)});
+    }
+}
+
+auto SigningPipeline::poll() -> std::vector<td::Result<BuilderData>>
+{
+    std::vector<td::Result<BuilderData>> result{};
+    while (!queue_.empty() && queue_.front().signature.wait_for(std::chrono::seconds{0}) == std::future_status::ready) {
+        result.emplace_back(complete(queue_.front()));
+        queue_.pop_front();
+    }
+    return result;
+}
+
+auto SigningPipeline::finish() -> std::vector<td::Result<BuilderData>>
+{
+    signer_.flush();
+
+    std::vector<td::Result<BuilderData>> result{};
+    result.reserve(queue_.size());
+    for (auto& entry : queue_) {
+        result.emplace_back(complete(entry));
+    }
+    queue_.clear();
+    return result;
+}
+
+auto SigningPipeline::complete(Entry& entry) -> td::Result<BuilderData>
+{
+    TRY_RESULT(signature, entry.signature.get())
+    return fill_signature(std::optional{std::move(signature)}, entry.call);
+}
+
+}  // namespace ftabi
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Abi.hpp"
+
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+
+namespace ftabi
+{
+using SignatureResult = td::Result<td::SecureString>;
+
+// signs hashes of unsigned message bodies, possibly in another process
+class Signer {
+public:
+    virtual ~Signer() = default;
+
+    virtual auto sign(const vm::CellHash& hash) -> std::future<SignatureResult> = 0;
+    // called when no more requests are expected soon, so that buffered ones can be sent
+    virtual auto flush() -> void {}
+};
+
+// signs synchronously with the key kept in memory
+class LocalSigner : public Signer {
+public:
+    static auto create(const td::Ed25519::PrivateKey& private_key) -> td::Result<LocalSigner>;
+    explicit LocalSigner(td::Ref<SigningKey> signing_key);
+
+    auto sign(const vm::CellHash& hash) -> std::future<SignatureResult> final;
+
+private:
+    td::Ref<SigningKey> signing_key_;
+};
+
+// groups requests into batches for an external signer. several batches may be in flight at once,
+// `transport` calls `done` with one result per hash, from any thread. calls after the first one are ignored,
+// requests of a batch fail if `done` is destroyed without being called
+class BatchingSigner : public Signer {
+public:
+    using Callback = std::function<void(std::vector<SignatureResult>&&)>;
+    using Transport = std::function<void(std::vector<vm::CellHash>&& hashes, Callback&& done)>;
+
+    explicit BatchingSigner(Transport transport, size_t max_batch_size = 64);
+    ~BatchingSigner() override;
+
+    auto sign(const vm::CellHash& hash) -> std::future<SignatureResult> final;
+    auto flush() -> void final;
+
+private:
+    struct Batch {
+        std::vector<vm::CellHash> hashes{};
+        std::vector<std::promise<SignatureResult>> promises{};
+    };
+
+    auto send(Batch&& batch) -> void;
+
+    Transport transport_;
+    size_t max_batch_size_;
+    std::mutex mutex_{};
+    Batch pending_{};
+};
+
+// prepares unsigned bodies while signatures for previous ones are still outstanding
+class SigningPipeline {
+public:
+    explicit SigningPipeline(Signer& signer);
+
+    auto submit(const Function& function, const HeaderSlots& header, const InputValues& inputs) -> td::Status;
+    // internal calls are rejected, they have no signature
+    auto submit(const Function& function, const FunctionCall& call) -> td::Status;
+    // hashes all bodies at once before they are passed to the signer. calls which failed to encode
+    // are queued too and reported by `poll` or `finish` in their place
+    auto submit(const Function& function, const std::vector<td::Ref<FunctionCall>>& calls) -> void;
+
+    auto pending() const -> size_t { return queue_.size(); }
+
+    // signed bodies whose signatures already arrived, in submission order
+    auto poll() -> std::vector<td::Result<BuilderData>>;
+    // flushes the signer and waits for all outstanding signatures
+    auto finish() -> std::vector<td::Result<BuilderData>>;
+
+private:
+    struct Entry {
+        UnsignedCall call;
+        std::future<SignatureResult> signature;
+    };
+
+    static auto complete(Entry& entry) -> td::Result<BuilderData>;
+
+    Signer& signer_;
+    std::deque<Entry> queue_{};
+};
+
+}  // namespace ftabi
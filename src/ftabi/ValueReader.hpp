@@ -0,0 +1,237 @@
+#pragma once
+
+#include "Abi.hpp"
+#include "BitReader.hpp"
+
+#include <utility>
+
+namespace ftabi
+{
+// per-type reading of values which are stored inline (ints, bool, grams, time, expire, public key and address).
+// values decoder, static runs, map keys, the visitor and the filter all go through it.
+// `f` receives int64_t / uint64_t for ints up to 64 bits and td::BigInt256 for wider ones, bool, GramAmount,
+// uint64_t for time, uint32_t for expire, std::optional<td::Bits256> and block::StdAddress (addr_none as default one)
+
+inline auto fetch_grams(BitReader& reader, GramAmount& value) -> bool
+{
+    uint64_t len;
+    if (!reader.fetch_ulong(4, len) || reader.remaining() < len * 8) {
+        return false;
+    }
+
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+    if (len > 8) {
+        reader.fetch_ulong(static_cast<unsigned>((len - 8) * 8), hi);
+        reader.fetch_ulong(64, lo);
+    }
+    else {
+        reader.fetch_ulong(static_cast<unsigned>(len * 8), lo);
+    }
+    value = GramAmount{hi, lo};
+    return true;
+}
+
+inline auto fetch_public_key(BitReader& reader, std::optional<td::Bits256>& value) -> bool
+{
+    bool has_value;
+    if (!reader.fetch_bool(has_value)) {
+        return false;
+    }
+    if (!has_value) {
+        value = std::nullopt;
+        return true;
+    }
+    td::Bits256 data;
+    if (!reader.fetch_bits_to(data)) {
+        return false;
+    }
+    value = data;
+    return true;
+}
+
+inline auto inline_value_error(ParamType type) -> td::Status
+{
+    switch (type) {
+        case ParamType::Uint:
+        case ParamType::Int:
+            return td::Status::Error("invalid value type. int or uint expected");
+        case ParamType::Bool:
+            return td::Status::Error("invalid value type. bool expected");
+        case ParamType::Gram:
+            return td::Status::Error("failed to parse grams");
+        case ParamType::Time:
+            return td::Status::Error("failed to fetch time");
+        case ParamType::Expire:
+            return td::Status::Error("failed to fetch expire");
+        case ParamType::PublicKey:
+            return td::Status::Error("failed to fetch public key");
+        case ParamType::Address:
+            return td::Status::Error("failed to fetch address. invalid format");
+        default:
+            return td::Status::Error("param is not stored inline");
+    }
+}
+
+template <typename F>
+auto read_inline_value(BitReader& reader, const Param& param, F&& f) -> td::Status
+{
+    bool ok = false;
+    switch (param.type()) {
+        case ParamType::Uint:
+        case ParamType::Int: {
+            const auto bits = static_cast<unsigned>(param.bit_len());
+            const auto sgnd = param.type() == ParamType::Int;
+            if (bits <= 64 && sgnd) {
+                int64_t value;
+                if ((ok = reader.fetch_long(bits, value))) {
+                    f(value);
+                }
+            }
+            else if (bits <= 64) {
+                uint64_t value;
+                if ((ok = reader.fetch_ulong(bits, value))) {
+                    f(value);
+                }
+            }
+            else {
+                td::BigInt256 value;
+                if ((ok = reader.fetch_int256(bits, sgnd, value))) {
+                    f(value);
+                }
+            }
+            break;
+        }
+        case ParamType::Bool: {
+            bool value;
+            if ((ok = reader.fetch_bool(value))) {
+                f(value);
+            }
+            break;
+        }
+        case ParamType::Gram: {
+            GramAmount value;
+            if ((ok = fetch_grams(reader, value))) {
+                f(value);
+            }
+            break;
+        }
+        case ParamType::Time: {
+            uint64_t value;
+            if ((ok = reader.fetch_ulong(64, value))) {
+                f(value);
+            }
+            break;
+        }
+        case ParamType::Expire: {
+            uint64_t value;
+            if ((ok = reader.fetch_ulong(32, value))) {
+                f(static_cast<uint32_t>(value));
+            }
+            break;
+        }
+        case ParamType::PublicKey: {
+            std::optional<td::Bits256> value;
+            if ((ok = fetch_public_key(reader, value))) {
+                f(value);
+            }
+            break;
+        }
+        case ParamType::Address: {
+            block::StdAddress value;
+            if ((ok = reader.fetch_address(value))) {
+                f(value);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return ok ? td::Status::OK() : inline_value_error(param.type());
+}
+
+// inline values are not split between cells, so the next cell of the chain is entered before the first bit
+template <typename F>
+auto read_inline_value(vm::CellSlice& cursor, const Param& param, DecodeBudget& budget, F&& f) -> td::Status
+{
+    const auto first_bits = param.type() == ParamType::Uint || param.type() == ParamType::Int ? static_cast<unsigned>(param.bit_len()) : 1;
+    if (!ensure_bits(cursor, first_bits, budget)) {
+        return budget.exceeded() ? budget.status() : inline_value_error(param.type());
+    }
+
+    BitReader reader{cursor};
+    TRY_STATUS(read_inline_value(reader, param, std::forward<F>(f)))
+    CHECK(cursor.advance(reader.consumed()))
+    return td::Status::OK();
+}
+
+// map keys must take exactly the key bits, so addr_none and anycast addresses are rejected
+template <typename F>
+auto read_map_key(BitReader& key, const Param& param, F&& f) -> td::Status
+{
+    if (read_inline_value(key, param, std::forward<F>(f)).is_error() || key.remaining() != 0) {
+        return td::Status::Error(param.type() == ParamType::Address ? "only std non-anycast address can be used as map key" : "failed to decode map key");
+    }
+    return td::Status::OK();
+}
+
+// glues bytes of the cell chain into `result`, which is any buffer with `size`, `resize` and `data`
+template <typename Buffer>
+auto read_bytes(vm::CellSlice& cursor, const Param& param, bool last, DecodeBudget& budget, Buffer& result) -> td::Status
+{
+    TRY_RESULT(cell, read_cell(cursor, last, budget))
+
+    result.resize(0);
+    auto cs = vm::load_cell_slice(cell);
+    while (true) {
+        if (!budget.visit_cell() || !budget.consume_bytes(cs.size() / 8)) {
+            return budget.status();
+        }
+
+        const auto offset = result.size();
+        result.resize(offset + cs.size() / 8);
+        if (!cs.fetch_bytes(result.data() + offset, static_cast<int>(result.size() - offset))) {
+            return td::Status::Error("failed to fetch slice");
+        }
+
+        if (!cs.fetch_ref_to(cell)) {
+            break;
+        }
+        cs = vm::load_cell_slice(cell);
+    }
+
+    if (param.type() == ParamType::FixedBytes && result.size() != static_cast<const ParamFixedBytes&>(param).size) {
+        return td::Status::Error("size of fixed bytes is not correspond to expected size");
+    }
+    return td::Status::OK();
+}
+
+// widens numbers passed by `read_inline_value`
+inline auto to_bigint(int64_t value) -> td::BigInt256
+{
+    return td::make_bigint(value);
+}
+
+inline auto to_bigint(uint64_t value) -> td::BigInt256
+{
+    td::BigInt256 result;
+    result.set_ulong(value);
+    return result;
+}
+
+inline auto to_bigint(GramAmount value) -> td::BigInt256
+{
+    unsigned char bytes[16];
+    for (size_t i = 8; i > 0; --i) {
+        bytes[i - 1] = static_cast<unsigned char>(value.hi);
+        bytes[i + 7] = static_cast<unsigned char>(value.lo);
+        value.hi >>= 8u;
+        value.lo >>= 8u;
+    }
+
+    td::BigInt256 result;
+    CHECK(result.import_bytes(bytes, sizeof(bytes), false))
+    return result;
+}
+
+}  // namespace ftabi
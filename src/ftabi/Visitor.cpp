@@ -0,0 +1,173 @@
+#include "Visitor.hpp"
+
+#include "ValueReader.hpp"
+
+namespace ftabi
+{
+namespace
+{
+class ParamWalker {
+public:
+    ParamWalker(DecodeVisitor& visitor, DecodeBudget& budget)
+        : visitor_{visitor}
+        , budget_{budget}
+    {
+    }
+
+    auto walk(vm::CellSlice& cursor, const std::vector<ParamRef>& params) -> td::Status
+    {
+        for (size_t i = 0; i < params.size(); ++i) {
+            path_.emplace_back(i);
+            auto status = visit(cursor, *params[i], i + 1 == params.size());
+            path_.pop_back();
+            if (status.is_error()) {
+                return budget_.exceeded() ? budget_.status() : std::move(status);
+            }
+        }
+
+        if (!cursor.empty_ext()) {
+            return td::Status::Error("incomplete deserialization");
+        }
+        return td::Status::OK();
+    }
+
+private:
+    auto path() const -> td::Span<size_t> { return td::Span<size_t>{path_}; }
+
+    auto visit(vm::CellSlice& cursor, const Param& param, bool last) -> td::Status
+    {
+        switch (param.type()) {
+            case ParamType::Cell: {
+                TRY_RESULT(cell, read_cell(cursor, last, budget_))
+                visitor_.on_cell(path(), param, cell);
+                return td::Status::OK();
+            }
+            case ParamType::Bytes:
+            case ParamType::FixedBytes:
+                TRY_STATUS(read_bytes(cursor, param, last, budget_, scratch_))
+                visitor_.on_bytes(path(), param, td::Slice{scratch_.data(), scratch_.size()});
+                return td::Status::OK();
+            case ParamType::Tuple:
+                return visit_tuple(cursor, param, last);
+            case ParamType::Map:
+                return visit_map(cursor, param, last);
+            case ParamType::Array:
+            case ParamType::FixedArray:
+                return td::Status::Error("arrays are not supported");
+            default:
+                return read_inline_value(cursor, param, budget_, [&](const auto& value) { emit(param, value); });
+        }
+    }
+
+    auto visit_tuple(vm::CellSlice& cursor, const Param& param, bool last) -> td::Status
+    {
+        const auto& items = static_cast<const ParamTuple&>(param).items;
+        if (!budget_.enter()) {
+            return budget_.status();
+        }
+
+        visitor_.begin_tuple(path(), param);
+        for (size_t i = 0; i < items.size(); ++i) {
+            path_.emplace_back(i);
+            auto status = visit(cursor, *items[i], last && i + 1 == items.size());
+            path_.pop_back();
+            TRY_STATUS(std::move(status))
+        }
+        visitor_.end_tuple(path(), param);
+
+        budget_.leave();
+        return td::Status::OK();
+    }
+
+    auto visit_map(vm::CellSlice& cursor, const Param& param, bool last) -> td::Status
+    {
+        const auto& map = static_cast<const ParamMap&>(param);
+
+        visitor_.begin_map(path(), param);
+        size_t entry = 0;
+        TRY_STATUS(read_map(cursor, map, last, budget_, [&](BitReader& key, vm::CellSlice& value) -> td::Status {
+            path_.emplace_back(entry++);
+            path_.emplace_back(0);
+            auto status = read_map_key(key, *map.key, [&](const auto& number) { emit(*map.key, number); });
+            if (status.is_ok()) {
+                path_.back() = 1;
+                status = visit(value, *map.value, true);
+            }
+            path_.pop_back();
+            path_.pop_back();
+            return status;
+        }))
+        visitor_.end_map(path(), param);
+        return td::Status::OK();
+    }
+
+    auto emit(const Param& param, uint64_t value) -> void
+    {
+        if (param.type() == ParamType::Time) {
+            visitor_.on_time(path(), param, value);
+        }
+        else {
+            visitor_.on_uint(path(), param, value);
+        }
+    }
+    auto emit(const Param& param, int64_t value) -> void { visitor_.on_int(path(), param, value); }
+    auto emit(const Param& param, const td::BigInt256& value) -> void { visitor_.on_big_int(path(), param, value); }
+    auto emit(const Param& param, bool value) -> void { visitor_.on_bool(path(), param, value); }
+    auto emit(const Param& param, GramAmount value) -> void { visitor_.on_gram(path(), param, value); }
+    auto emit(const Param& param, uint32_t value) -> void { visitor_.on_expire(path(), param, value); }
+    auto emit(const Param& param, const block::StdAddress& value) -> void { visitor_.on_address(path(), param, value); }
+    auto emit(const Param& param, const std::optional<td::Bits256>& value) -> void
+    {
+        visitor_.on_public_key(path(), param, value.has_value() ? value->as_slice() : td::Slice{});
+    }
+
+    DecodeVisitor& visitor_;
+    DecodeBudget& budget_;
+    std::vector<size_t> path_{};
+    std::vector<uint8_t> scratch_{};
+};
+
+}  // namespace
+
+auto visit_params(vm::CellSlice& cursor, const std::vector<ParamRef>& params, DecodeVisitor& visitor) -> td::Status
+{
+    DecodeBudget budget{};
+    return visit_params(cursor, params, visitor, budget);
+}
+
+auto visit_params(vm::CellSlice& cursor, const std::vector<ParamRef>& params, DecodeVisitor& visitor, DecodeBudget& budget) -> td::Status
+{
+    return ParamWalker{visitor, budget}.walk(cursor, params);
+}
+
+auto visit_input(const Function& function, vm::CellSlice& cursor, bool internal, DecodeVisitor& visitor) -> td::Result<DecodedInput>
+{
+    return visit_input(function, cursor, internal, visitor, DecodeLimits{});
+}
+
+auto visit_input(const Function& function, vm::CellSlice& cursor, bool internal, DecodeVisitor& visitor, const DecodeLimits& limits)
+    -> td::Result<DecodedInput>
+{
+    DecodeBudget budget{limits};
+    TRY_RESULT(result, function.decode_input_header(cursor, internal, budget))
+    if (result.function_id != function.input_id()) {
+        return td::Status::Error("invalid input_id");
+    }
+    TRY_STATUS(visit_params(cursor, function.inputs(), visitor, budget))
+    return std::move(result);
+}
+
+auto visit_output(const Function& function, vm::CellSlice& cursor, DecodeVisitor& visitor) -> td::Status
+{
+    return visit_output(function, cursor, visitor, DecodeLimits{});
+}
+
+auto visit_output(const Function& function, vm::CellSlice& cursor, DecodeVisitor& visitor, const DecodeLimits& limits) -> td::Status
+{
+    TRY_STATUS(function.decode_output_id(cursor))
+
+    DecodeBudget budget{limits};
+    return visit_params(cursor, function.outputs(), visitor, budget);
+}
+
+}  // namespace ftabi
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Abi.hpp"
+
+#include <td/utils/Span.h>
+
+namespace ftabi
+{
+// receives values while cells are walked, without creating `Value` objects.
+// `path` holds indices of the param and of enclosing tuple items, map entries add the entry index followed
+// by 0 for the key and 1 for the value; slices are valid only during the call
+class DecodeVisitor {
+public:
+    virtual ~DecodeVisitor() = default;
+
+    // uint and int up to 64 bits
+    virtual auto on_uint(td::Span<size_t> path, const Param& param, uint64_t value) -> void {}
+    virtual auto on_int(td::Span<size_t> path, const Param& param, int64_t value) -> void {}
+    // wider uint and int
+    virtual auto on_big_int(td::Span<size_t> path, const Param& param, const td::BigInt256& value) -> void {}
+    virtual auto on_bool(td::Span<size_t> path, const Param& param, bool value) -> void {}
+    virtual auto on_gram(td::Span<size_t> path, const Param& param, GramAmount value) -> void {}
+    virtual auto on_time(td::Span<size_t> path, const Param& param, uint64_t value) -> void {}
+    virtual auto on_expire(td::Span<size_t> path, const Param& param, uint32_t value) -> void {}
+    // addr_none is reported as default constructed address
+    virtual auto on_address(td::Span<size_t> path, const Param& param, const block::StdAddress& value) -> void {}
+    virtual auto on_bytes(td::Span<size_t> path, const Param& param, td::Slice value) -> void {}
+    virtual auto on_cell(td::Span<size_t> path, const Param& param, const td::Ref<vm::Cell>& value) -> void {}
+    // empty slice when key is not present
+    virtual auto on_public_key(td::Span<size_t> path, const Param& param, td::Slice value) -> void {}
+
+    virtual auto begin_tuple(td::Span<size_t> path, const Param& param) -> void {}
+    virtual auto end_tuple(td::Span<size_t> path, const Param& param) -> void {}
+    // entries are reported in key order, keys through `on_uint`, `on_int`, `on_big_int` or `on_address`
+    virtual auto begin_map(td::Span<size_t> path, const Param& param) -> void {}
+    virtual auto end_map(td::Span<size_t> path, const Param& param) -> void {}
+};
+
+auto visit_params(vm::CellSlice& cursor, const std::vector<ParamRef>& params, DecodeVisitor& visitor) -> td::Status;
+auto visit_params(vm::CellSlice& cursor, const std::vector<ParamRef>& params, DecodeVisitor& visitor, DecodeBudget& budget) -> td::Status;
+
+// checks function id and visits input params, the header is decoded as usual
+auto visit_input(const Function& function, vm::CellSlice& cursor, bool internal, DecodeVisitor& visitor) -> td::Result<DecodedInput>;
+auto visit_input(const Function& function, vm::CellSlice& cursor, bool internal, DecodeVisitor& visitor, const DecodeLimits& limits)
+    -> td::Result<DecodedInput>;
+
+// checks output id and visits output params
+auto visit_output(const Function& function, vm::CellSlice& cursor, DecodeVisitor& visitor) -> td::Status;
+auto visit_output(const Function& function, vm::CellSlice& cursor, DecodeVisitor& visitor, const DecodeLimits& limits) -> td::Status;
+
+}  // namespace ftabi
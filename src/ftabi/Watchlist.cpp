@@ -0,0 +1,133 @@
+#include "Watchlist.hpp"
+
+#include <algorithm>
+
+namespace ftabi
+{
+namespace
+{
+constexpr unsigned ADDR_STD_BIT_LENGTH = 3 /* tag and anycast */ + 8 /* workchain */ + 256 /* addr */;
+
+// two independent 64 bit hashes taken from the address itself
+auto address_hashes(ton::WorkchainId workchain, td::ConstBitPtr addr) -> std::pair<uint64_t, uint64_t>
+{
+    const auto first = addr.get_uint(64) ^ static_cast<uint64_t>(static_cast<int64_t>(workchain));
+    const auto second = (addr + 64).get_uint(64);
+    return std::make_pair(first, second);
+}
+
+auto compare_entry(const td::Bits256& left_addr, ton::WorkchainId left_workchain, td::ConstBitPtr right_addr, ton::WorkchainId right_workchain) -> int
+{
+    if (const auto cmp = td::bitstring::bits_memcmp(left_addr.data(), 0, right_addr.ptr, right_addr.offs, 256); cmp != 0) {
+        return cmp;
+    }
+    return (left_workchain > right_workchain) - (left_workchain < right_workchain);
+}
+
+}  // namespace
+
+AddressWatchlist::AddressWatchlist(const std::vector<block::StdAddress>& addresses, size_t bits_per_address)
+{
+    entries_.reserve(addresses.size());
+    for (const auto& address : addresses) {
+        entries_.emplace_back(Entry{address.addr, address.workchain});
+    }
+    std::sort(entries_.begin(), entries_.end(), [](const Entry& left, const Entry& right) {
+        return compare_entry(left.addr, left.workchain, right.addr.cbits(), right.workchain) < 0;
+    });
+    entries_.erase(std::unique(entries_.begin(), entries_.end(),
+                               [](const Entry& left, const Entry& right) { return left.workchain == right.workchain && left.addr == right.addr; }),
+                   entries_.end());
+
+    const auto total_bits = std::max<size_t>(entries_.size() * bits_per_address, 1);
+    blocks_.assign((total_bits + 511) / 512, Block{});
+
+    for (const auto& entry : entries_) {
+        const auto [first, second] = address_hashes(entry.workchain, entry.addr.cbits());
+        auto& block = blocks_[block_index(first)];
+        for (unsigned i = 0; i < 8; ++i) {
+            block.words[i] |= uint64_t{1} << ((second >> (6 * i)) & 63u);
+        }
+    }
+}
+
+auto AddressWatchlist::may_contain(ton::WorkchainId workchain, td::ConstBitPtr addr) const -> bool
+{
+    const auto [first, second] = address_hashes(workchain, addr);
+    const auto& block = blocks_[block_index(first)];
+
+    uint64_t missing = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        missing |= ~block.words[i] & (uint64_t{1} << ((second >> (6 * i)) & 63u));
+    }
+    return missing == 0;
+}
+
+auto AddressWatchlist::contains(ton::WorkchainId workchain, td::ConstBitPtr addr) const -> bool
+{
+    if (!may_contain(workchain, addr)) {
+        return false;
+    }
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), 0,
+                               [&](const Entry& entry, int) { return compare_entry(entry.addr, entry.workchain, addr, workchain) < 0; });
+    return it != entries_.end() && compare_entry(it->addr, it->workchain, addr, workchain) == 0;
+}
+
+auto AddressWatchlist::contains(const block::StdAddress& address) const -> bool
+{
+    return contains(address.workchain, address.addr.cbits());
+}
+
+auto AddressWatchlist::contains_at(const vm::CellSlice& cursor) const -> bool
+{
+    if (!cursor.have(ADDR_STD_BIT_LENGTH) || cursor.prefetch_ulong(3) != 0b100) {
+        return false;
+    }
+    const auto bits = cursor.data_bits();
+    const auto workchain = static_cast<ton::WorkchainId>(static_cast<int8_t>((bits + 3).get_uint(8)));
+    return contains(workchain, bits + 11);
+}
+
+auto AddressWatchlist::scan(const td::Ref<vm::Cell>& root, size_t max_cells) const -> bool
+{
+    if (entries_.empty() || root.is_null()) {
+        return false;
+    }
+
+    std::vector<td::Ref<vm::Cell>> stack{root};
+    size_t visited = 0;
+    while (!stack.empty()) {
+        if (visited++ == max_cells) {
+            return true;
+        }
+
+        auto cell = std::move(stack.back());
+        stack.pop_back();
+
+        bool is_special;
+        auto cs = vm::load_cell_slice_special(std::move(cell), is_special);
+        if (is_special) {
+            continue;
+        }
+
+        const auto bits = cs.data_bits();
+        const auto size = cs.size();
+        for (unsigned offset = 0; offset + ADDR_STD_BIT_LENGTH <= size; ++offset) {
+            const auto ptr = bits + offset;
+            if (ptr.get_uint(3) != 0b100) {
+                continue;
+            }
+            const auto workchain = static_cast<ton::WorkchainId>(static_cast<int8_t>((ptr + 3).get_uint(8)));
+            if (contains(workchain, ptr + 11)) {
+                return true;
+            }
+        }
+
+        for (unsigned i = 0; i < cs.size_refs(); ++i) {
+            stack.emplace_back(cs.prefetch_ref(i));
+        }
+    }
+    return false;
+}
+
+}  // namespace ftabi
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <block/block-parse.h>
+
+#include <vector>
+
+namespace ftabi
+{
+// set of watched std addresses: cache line sized bloom filter blocks in front of a sorted array.
+// addresses are hashes already, so their bits are used as bloom hashes directly
+class AddressWatchlist {
+public:
+    explicit AddressWatchlist(const std::vector<block::StdAddress>& addresses, size_t bits_per_address = 16);
+
+    auto size() const -> size_t { return entries_.size(); }
+    auto empty() const -> bool { return entries_.empty(); }
+
+    auto may_contain(ton::WorkchainId workchain, td::ConstBitPtr addr) const -> bool;
+    auto contains(ton::WorkchainId workchain, td::ConstBitPtr addr) const -> bool;
+    auto contains(const block::StdAddress& address) const -> bool;
+
+    // checks addr_std$10 at the cursor position without advancing it
+    auto contains_at(const vm::CellSlice& cursor) const -> bool;
+
+    // looks for any watched address serialized as addr_std anywhere in the cell tree.
+    // may visit at most `max_cells` cells, returns true if the limit was reached
+    auto scan(const td::Ref<vm::Cell>& root, size_t max_cells = 64) const -> bool;
+
+private:
+    struct alignas(64) Block {
+        uint64_t words[8];
+    };
+
+    struct Entry {
+        td::Bits256 addr;
+        ton::WorkchainId workchain;
+    };
+
+    auto block_index(uint64_t hash) const -> size_t { return static_cast<size_t>(((hash >> 32u) * blocks_.size()) >> 32u); }
+
+    std::vector<Block> blocks_{};
+    std::vector<Entry> entries_{};
+};
+
+}  // namespace ftabi
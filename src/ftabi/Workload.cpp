@@ -0,0 +1,359 @@
+#include "Workload.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <unordered_set>
+
+namespace ftabi
+{
+namespace
+{
+constexpr size_t COMMON_INT_SIZES[] = {8, 16, 32, 64, 128, 256};
+constexpr size_t KEY_INT_SIZES[] = {8, 16, 32, 64, 256};
+
+constexpr td::uint64 MIN_TIME = 1600000000000ull;
+constexpr td::uint64 TIME_RANGE = 100000000000ull;
+
+}  // namespace
+
+WorkloadGenerator::WorkloadGenerator(WorkloadOptions options)
+    : options_{std::move(options)}
+    , rng_{options_.seed}
+{
+}
+
+// params
+
+auto WorkloadGenerator::random_param(const std::string& name, size_t depth) -> ParamRef
+{
+    return random_param(name, random_type(depth), depth);
+}
+
+auto WorkloadGenerator::random_param(const std::string& name, ParamType type, size_t depth) -> ParamRef
+{
+    switch (type) {
+        case ParamType::Uint:
+        case ParamType::Int: {
+            const auto size = chance(0.5) ? COMMON_INT_SIZES[rng_() % std::size(COMMON_INT_SIZES)] : 1 + rng_() % 256;
+            if (type == ParamType::Uint) {
+                return ParamRef{ParamUint{name, size}};
+            }
+            return ParamRef{ParamInt{name, size}};
+        }
+        case ParamType::Bool:
+            return ParamRef{ParamBool{name}};
+        case ParamType::Tuple: {
+            const auto count = std::max<size_t>(random_size(options_.tuple_items), 1);
+            std::vector<ParamRef> items{};
+            items.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                items.emplace_back(random_param(name + "_" + std::to_string(i), depth + 1));
+            }
+            return ParamRef{ParamTuple{name, std::move(items)}};
+        }
+        case ParamType::Array:
+            return ParamRef{ParamArray{name, random_param("item", depth + 1)}};
+        case ParamType::FixedArray:
+            return ParamRef{ParamFixedArray{name, random_param("item", depth + 1), 1 + rng_() % 8}};
+        case ParamType::Cell:
+            return ParamRef{ParamCell{name}};
+        case ParamType::Map:
+            return ParamRef{ParamMap{name, random_key_param("key"), random_param("value", depth + 1)}};
+        case ParamType::Address:
+            return ParamRef{ParamAddress{name}};
+        case ParamType::Bytes:
+            return ParamRef{ParamBytes{name}};
+        case ParamType::FixedBytes:
+            return ParamRef{ParamFixedBytes{name, 1 + rng_() % 32}};
+        case ParamType::Gram:
+            return ParamRef{ParamGram{name}};
+        case ParamType::Time:
+            return ParamRef{ParamTime{name}};
+        case ParamType::Expire:
+            return ParamRef{ParamExpire{name}};
+        case ParamType::PublicKey:
+            return ParamRef{ParamPublicKey{name}};
+        default:
+            return ParamRef{ParamUint{name, 32}};
+    }
+}
+
+auto WorkloadGenerator::random_header() -> HeaderParams
+{
+    HeaderParams result{};
+    if (chance(options_.header_probability)) {
+        result.emplace_back(ParamRef{ParamPublicKey{"pubkey"}});
+    }
+    if (chance(options_.header_probability)) {
+        result.emplace_back(ParamRef{ParamTime{"time"}});
+    }
+    if (chance(options_.header_probability)) {
+        result.emplace_back(ParamRef{ParamExpire{"expire"}});
+    }
+    return result;
+}
+
+auto WorkloadGenerator::random_function(std::string name) -> td::Ref<Function>
+{
+    return random_function(std::move(name), random_header());
+}
+
+auto WorkloadGenerator::random_contract(std::string name) -> td::Ref<Contract>
+{
+    const auto header = random_header();
+    const auto count = std::max<size_t>(random_size(options_.functions), 1);
+
+    std::vector<td::Ref<Function>> functions{};
+    functions.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        functions.emplace_back(random_function(name + "_method" + std::to_string(i), header));
+    }
+    return td::Ref<Contract>{true, std::move(name), std::move(functions)};
+}
+
+auto WorkloadGenerator::random_function(std::string name, const HeaderParams& header) -> td::Ref<Function>
+{
+    auto inputs = random_params("input", options_.inputs);
+    auto outputs = random_params("output", options_.outputs);
+    return td::Ref<Function>{true, std::move(name), HeaderParams{header}, std::move(inputs), std::move(outputs)};
+}
+
+auto WorkloadGenerator::random_params(const std::string& prefix, const SizeDistribution& count) -> std::vector<ParamRef>
+{
+    const auto size = random_size(count);
+    std::vector<ParamRef> result{};
+    result.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        result.emplace_back(random_param(prefix + std::to_string(i)));
+    }
+    return result;
+}
+
+auto WorkloadGenerator::random_key_param(const std::string& name) -> ParamRef
+{
+    switch (rng_() % 3) {
+        case 0:
+            return ParamRef{ParamUint{name, KEY_INT_SIZES[rng_() % std::size(KEY_INT_SIZES)]}};
+        case 1:
+            return ParamRef{ParamInt{name, KEY_INT_SIZES[rng_() % std::size(KEY_INT_SIZES)]}};
+        default:
+            return ParamRef{ParamAddress{name}};
+    }
+}
+
+// values
+
+auto WorkloadGenerator::random_value(const ParamRef& param) -> td::Result<ValueRef>
+{
+    switch (param->type()) {
+        case ParamType::Uint:
+        case ParamType::Int:
+            return ValueRef{ValueInt{param, random_int(param->bit_len(), param->type() == ParamType::Int)}};
+        case ParamType::Bool:
+            return ValueRef{ValueBool{param, (rng_() & 1u) != 0}};
+        case ParamType::Tuple: {
+            const auto& items = static_cast<const ParamTuple&>(*param).items;
+            std::vector<ValueRef> values{};
+            values.reserve(items.size());
+            for (const auto& item : items) {
+                TRY_RESULT(value, random_value(item))
+                values.emplace_back(std::move(value));
+            }
+            return ValueRef{ValueTuple{param, std::move(values)}};
+        }
+        case ParamType::Cell:
+            return ValueRef{ValueCell{param, random_cell(0)}};
+        case ParamType::Map: {
+            const auto& map = static_cast<const ParamMap&>(*param);
+            const auto count = random_size(options_.map_entries);
+
+            // keys of small integer types run out quickly, so there may be fewer entries
+            std::unordered_set<ValueRef, ValueHash, ValueEqual> keys{};
+            std::vector<std::pair<ValueRef, ValueRef>> entries{};
+            entries.reserve(count);
+            for (size_t i = 0; i < count * 2 && entries.size() < count; ++i) {
+                ValueRef key{};
+                if (map.key->type() == ParamType::Address) {
+                    key = ValueRef{ValueAddress{map.key, random_address()}};
+                }
+                else {
+                    TRY_RESULT_ASSIGN(key, random_value(map.key))
+                }
+                if (!keys.emplace(key).second) {
+                    continue;
+                }
+                TRY_RESULT(value, random_value(map.value))
+                entries.emplace_back(std::move(key), std::move(value));
+            }
+            return ValueRef{ValueMap{param, std::move(entries)}};
+        }
+        case ParamType::Address:
+            return ValueRef{ValueAddress{param, chance(options_.empty_probability) ? block::StdAddress{ton::basechainId, td::Bits256::zero()} : random_address()}};
+        case ParamType::Bytes:
+        case ParamType::FixedBytes: {
+            const auto size = param->type() == ParamType::Bytes ? random_size(options_.bytes_length) : static_cast<const ParamFixedBytes&>(*param).size;
+            InlineBytes bytes{size};
+            for (size_t i = 0; i < size; ++i) {
+                bytes.data()[i] = static_cast<uint8_t>(rng_());
+            }
+            return ValueRef{ValueBytes{param, std::move(bytes)}};
+        }
+        case ParamType::Gram: {
+            // VarUInteger 16 holds at most 15 bytes
+            const auto bits = static_cast<unsigned>(rng_() % 121);
+            const auto high = rng_();
+            const auto low = rng_();
+            // the top `bits` bits of the 128 bit number
+            GramAmount value{};
+            if (bits > 64) {
+                value.hi = high >> (128u - bits);
+                value.lo = (high << (bits - 64u)) | (low >> (128u - bits));
+            }
+            else if (bits > 0) {
+                value.lo = high >> (64u - bits);
+            }
+            return ValueRef{ValueGram{param, value}};
+        }
+        case ParamType::Time:
+            return ValueRef{ValueTime{param, MIN_TIME + rng_() % TIME_RANGE}};
+        case ParamType::Expire:
+            return ValueRef{ValueExpire{param, static_cast<uint32_t>(rng_())}};
+        case ParamType::PublicKey: {
+            if (chance(options_.empty_probability)) {
+                return ValueRef{ValuePublicKey{param, std::optional<td::Bits256>{}}};
+            }
+            td::Bits256 key{};
+            for (int i = 0; i < 4; ++i) {
+                (key.bits() + i * 64).store_uint(rng_(), 64);
+            }
+            return ValueRef{ValuePublicKey{param, std::optional{key}}};
+        }
+        default:
+            return td::Status::Error("random values of this type are not supported");
+    }
+}
+
+auto WorkloadGenerator::random_inputs(const Function& function) -> td::Result<InputValues>
+{
+    InputValues result{};
+    result.reserve(function.inputs().size());
+    for (const auto& param : function.inputs()) {
+        TRY_RESULT(value, random_value(param))
+        result.emplace_back(std::move(value));
+    }
+    return std::move(result);
+}
+
+auto WorkloadGenerator::random_header_values(const Function& function) -> td::Result<HeaderValues>
+{
+    HeaderValues result{};
+    for (const auto& param : function.header()) {
+        TRY_RESULT(value, random_value(param))
+        result.emplace(param->name(), std::move(value));
+    }
+    return std::move(result);
+}
+
+auto WorkloadGenerator::random_call(const Function& function, bool internal) -> td::Result<td::Ref<FunctionCall>>
+{
+    HeaderValues header{};
+    if (!internal) {
+        TRY_RESULT_ASSIGN(header, random_header_values(function))
+    }
+    TRY_RESULT(inputs, random_inputs(function))
+    return td::Ref<FunctionCall>{true, std::move(header), std::move(inputs), internal, std::nullopt};
+}
+
+auto WorkloadGenerator::random_body(const Function& function, bool internal) -> td::Result<BuilderData>
+{
+    TRY_RESULT(call, random_call(function, internal))
+    return function.encode_input(call);
+}
+
+// helpers
+
+auto WorkloadGenerator::random_size(const SizeDistribution& distribution) -> size_t
+{
+    if (distribution.max <= distribution.min) {
+        return distribution.min;
+    }
+    // uniform double from the top 53 bits, so that sequences don't depend on the standard library
+    const auto uniform = static_cast<double>(rng_() >> 11u) * 0x1.0p-53;
+    const auto range = static_cast<double>(distribution.max - distribution.min + 1);
+    const auto offset = static_cast<size_t>(range * std::pow(uniform, distribution.skew));
+    return std::min(distribution.min + offset, distribution.max);
+}
+
+auto WorkloadGenerator::random_type(size_t depth) -> ParamType
+{
+    auto weights = options_.type_weights;
+    if (depth >= options_.max_depth) {
+        for (const auto type : {ParamType::Tuple, ParamType::Map, ParamType::Array, ParamType::FixedArray}) {
+            weights[static_cast<size_t>(type)] = 0;
+        }
+    }
+
+    uint64_t total = 0;
+    for (const auto weight : weights) {
+        total += weight;
+    }
+    if (total == 0) {
+        return ParamType::Uint;
+    }
+
+    auto point = rng_() % total;
+    for (size_t i = 0; i < weights.size(); ++i) {
+        if (point < weights[i]) {
+            return static_cast<ParamType>(i);
+        }
+        point -= weights[i];
+    }
+    return ParamType::Uint;
+}
+
+auto WorkloadGenerator::random_int(size_t bits, bool sgnd) -> td::BigInt256
+{
+    td::Bits256 data{};
+    for (int i = 0; i < 4; ++i) {
+        (data.bits() + i * 64).store_uint(rng_(), 64);
+    }
+
+    td::BigInt256 result;
+    CHECK(result.import_bits(data.cbits(), static_cast<int>(bits), sgnd))
+    return result;
+}
+
+auto WorkloadGenerator::random_address() -> block::StdAddress
+{
+    block::StdAddress result{};
+    result.workchain = chance(0.1) ? ton::masterchainId : ton::basechainId;
+    for (int i = 0; i < 4; ++i) {
+        (result.addr.bits() + i * 64).store_uint(rng_(), 64);
+    }
+    return result;
+}
+
+auto WorkloadGenerator::random_cell(size_t depth) -> td::Ref<vm::Cell>
+{
+    const auto bits = static_cast<unsigned>(std::min<size_t>(random_size(options_.cell_bits), vm::CellTraits::max_bits));
+
+    vm::CellBuilder cb{};
+    for (unsigned i = 0; i < bits; i += 64) {
+        CHECK(cb.store_ulong_rchk_bool(rng_() >> (64u - std::min(64u, bits - i)), std::min(64u, bits - i)))
+    }
+    if (depth < options_.max_depth && !chance(options_.empty_probability)) {
+        const auto refs = rng_() % 3;
+        for (size_t i = 0; i < refs; ++i) {
+            CHECK(cb.store_ref_bool(random_cell(depth + 1)))
+        }
+    }
+    return cb.finalize();
+}
+
+auto WorkloadGenerator::chance(double probability) -> bool
+{
+    return static_cast<double>(rng_() >> 11u) * 0x1.0p-53 < probability;
+}
+
+}  // namespace ftabi
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "Abi.hpp"
+
+#include <array>
+#include <random>
+
+namespace ftabi
+{
+// random size in [min, max]. skew above 1 makes small sizes more likely, below 1 - large ones
+struct SizeDistribution {
+    size_t min{0};
+    size_t max{0};
+    double skew{1.0};
+};
+
+struct WorkloadOptions {
+    static constexpr size_t PARAM_TYPE_COUNT = static_cast<size_t>(ParamType::PublicKey) + 1;
+
+    uint64_t seed{0};
+
+    // relative probability of each param type, indexed by `ParamType`. arrays have no values yet,
+    // time, expire and public key are header only types, so they are disabled
+    std::array<uint32_t, PARAM_TYPE_COUNT> type_weights{
+        /* Uint */ 8, /* Int */ 4, /* Bool */ 2, /* Tuple */ 2, /* Array */ 0, /* FixedArray */ 0, /* Cell */ 1, /* Map */ 1,
+        /* Address */ 4, /* Bytes */ 2, /* FixedBytes */ 1, /* Gram */ 3, /* Time */ 0, /* Expire */ 0, /* PublicKey */ 0};
+
+    SizeDistribution functions{1, 16, 1.0};
+    SizeDistribution inputs{0, 8, 1.5};
+    SizeDistribution outputs{0, 4, 1.5};
+    SizeDistribution tuple_items{1, 6, 1.5};
+    SizeDistribution map_entries{0, 64, 2.0};
+    SizeDistribution bytes_length{0, 512, 3.0};
+    SizeDistribution cell_bits{0, 1023, 2.0};
+    // tuples and maps deeper than this get only plain params
+    size_t max_depth{3};
+
+    // probability of each of `pubkey`, `time` and `expire` header params
+    double header_probability{0.5};
+    // probability of an empty public key or cell value, or of the zero address
+    double empty_probability{0.1};
+};
+
+// generates valid abis, values and bodies for benchmarks and stress tests.
+// output depends only on options and on the order of calls
+class WorkloadGenerator {
+public:
+    explicit WorkloadGenerator(WorkloadOptions options = {});
+
+    auto options() const -> const WorkloadOptions& { return options_; }
+
+    auto random_param(const std::string& name, size_t depth = 0) -> ParamRef;
+    auto random_param(const std::string& name, ParamType type, size_t depth = 0) -> ParamRef;
+    auto random_header() -> HeaderParams;
+    auto random_function(std::string name) -> td::Ref<Function>;
+    // all functions share the same header
+    auto random_contract(std::string name) -> td::Ref<Contract>;
+
+    auto random_value(const ParamRef& param) -> td::Result<ValueRef>;
+    auto random_inputs(const Function& function) -> td::Result<InputValues>;
+    auto random_header_values(const Function& function) -> td::Result<HeaderValues>;
+    auto random_call(const Function& function, bool internal) -> td::Result<td::Ref<FunctionCall>>;
+    // encoded call body, external ones are unsigned
+    auto random_body(const Function& function, bool internal) -> td::Result<BuilderData>;
+
+private:
+    auto random_function(std::string name, const HeaderParams& header) -> td::Ref<Function>;
+    auto random_params(const std::string& prefix, const SizeDistribution& count) -> std::vector<ParamRef>;
+    auto random_size(const SizeDistribution& distribution) -> size_t;
+    auto random_type(size_t depth) -> ParamType;
+    auto random_key_param(const std::string& name) -> ParamRef;
+    auto random_int(size_t bits, bool sgnd) -> td::BigInt256;
+    auto random_address() -> block::StdAddress;
+    auto random_cell(size_t depth) -> td::Ref<vm::Cell>;
+    auto chance(double probability) -> bool;
+
+    WorkloadOptions options_;
+    std::mt19937_64 rng_;
+};
+
+}  // namespace ftabi
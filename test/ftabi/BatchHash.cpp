@@ -0,0 +1,79 @@
+#include "BatchHash.hpp"
+
+#include <td/utils/crypto.h>
+#include <td/utils/tests.h>
+
+#include <vector>
+
+using namespace ftabi;
+
+// all lengths up to 200 bytes cover one and two block tails. batches of 1 to 17 messages leave
+// some lanes idle, the full batch refills lanes with messages of other lengths
+TEST(BatchHash, kernels_match_sha256)
+{
+    constexpr size_t max_length = 200;
+    std::vector<unsigned char> data(max_length);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<unsigned char>(i * 131u + 7u);
+    }
+
+    std::vector<td::Slice> messages{};
+    for (size_t length = 0; length <= max_length; ++length) {
+        messages.emplace_back(td::Slice{data.data(), length});
+    }
+
+    std::vector<unsigned char> expected(messages.size() * 32);
+    for (size_t i = 0; i < messages.size(); ++i) {
+        td::sha256(messages[i], td::MutableSlice{expected.data() + i * 32, 32});
+    }
+    const auto expected_digest = [&](size_t i) { return td::Slice{expected.data() + i * 32, 32}; };
+
+    std::vector<unsigned char> actual(messages.size() * 32);
+    for (const auto& [name, kernel] : sha256_batch_kernels()) {
+        LOG(INFO) << "checking " << name << " kernel";
+
+        for (size_t count = 1; count <= 17; ++count) {
+            const auto offset = messages.size() - count;
+            kernel(td::Span<td::Slice>{messages.data() + offset, count}, actual.data());
+            for (size_t i = 0; i < count; ++i) {
+                ASSERT_EQ(expected_digest(offset + i), td::Slice(actual.data() + i * 32, 32));
+            }
+        }
+
+        kernel(td::Span<td::Slice>{messages}, actual.data());
+        for (size_t i = 0; i < messages.size(); ++i) {
+            ASSERT_EQ(expected_digest(i), td::Slice(actual.data() + i * 32, 32));
+        }
+    }
+}
+
+TEST(BatchHash, cell_hashes_match_finalized_cells)
+{
+    vm::CellBuilder leaf_builder{};
+    CHECK(leaf_builder.store_long_bool(0x1234, 16))
+    const auto leaf = leaf_builder.finalize();
+
+    std::vector<td::Ref<vm::Cell>> cells{};
+    for (unsigned bits = 0; bits <= 1023; bits += 31) {
+        vm::CellBuilder cb{};
+        for (unsigned i = 0; i < bits; ++i) {
+            CHECK(cb.store_long_bool((i * 7u) % 3u == 0, 1))
+        }
+        for (unsigned i = 0; i < bits % 5; ++i) {
+            CHECK(cb.store_ref_bool(leaf))
+        }
+        cells.emplace_back(cb.finalize());
+    }
+
+    CellHashBatch batch{};
+    batch.reserve(cells.size());
+    for (const auto& cell : cells) {
+        batch.add(vm::load_cell_slice(cell));
+    }
+
+    const auto hashes = batch.compute();
+    ASSERT_EQ(cells.size(), hashes.size());
+    for (size_t i = 0; i < cells.size(); ++i) {
+        ASSERT_EQ(cells[i]->get_hash().to_hex(), hashes[i].to_hex());
+    }
+}
@@ -0,0 +1,44 @@
+#include "Abi.hpp"
+#include "Workload.hpp"
+
+#include <td/utils/tests.h>
+
+#include <vector>
+
+using namespace ftabi;
+
+// batch encoding must produce the same bodies as the single call encoder
+TEST(Encode, batch_matches_single_calls)
+{
+    WorkloadOptions options{};
+    options.seed = 0x0f7ab1u;
+    WorkloadGenerator generator{options};
+
+    auto private_key = td::Ed25519::generate_private_key().move_as_ok();
+    auto signing_key = SigningKey::create(private_key).move_as_ok();
+
+    for (size_t i = 0; i < 64; ++i) {
+        auto function = generator.random_function("function_" + std::to_string(i));
+
+        std::vector<td::Ref<FunctionCall>> calls{};
+        calls.emplace_back(generator.random_call(*function, false).move_as_ok());
+        calls.emplace_back(generator.random_call(*function, true).move_as_ok());
+
+        auto with_private_key = generator.random_call(*function, false).move_as_ok();
+        with_private_key.write().private_key = td::Ed25519::PrivateKey{private_key.as_octet_string().copy()};
+        calls.emplace_back(std::move(with_private_key));
+
+        auto with_signing_key = generator.random_call(*function, false).move_as_ok();
+        with_signing_key.write().signing_key = signing_key;
+        calls.emplace_back(std::move(with_signing_key));
+
+        auto batch = function->encode_inputs(calls);
+        ASSERT_EQ(calls.size(), batch.size());
+        for (size_t j = 0; j < calls.size(); ++j) {
+            auto single = function->encode_input(calls[j]);
+            ASSERT_TRUE(single.is_ok());
+            ASSERT_TRUE(batch[j].is_ok());
+            ASSERT_EQ(single.ok()->get_hash().to_hex(), batch[j].ok()->get_hash().to_hex());
+        }
+    }
+}
@@ -0,0 +1,7 @@
+#include <td/utils/tests.h>
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    td::TestsRunner::get_default().run_all();
+    return 0;
+}